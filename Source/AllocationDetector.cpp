@@ -0,0 +1,174 @@
+#include "AllocationDetector.h"
+
+#if NOISAT_DETECT_AUDIO_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+#endif
+
+namespace {
+thread_local int noAllocationDepth = 0;
+std::atomic<int> numViolations{ 0 };
+
+void checkAllocation() {
+    if (noAllocationDepth == 0) return;
+    numViolations++;
+
+    // Leave the region while asserting, the assertion handler may allocate.
+    auto depth = std::exchange(noAllocationDepth, 0);
+    jassertfalse;
+    noAllocationDepth = depth;
+}
+
+void* rawAllocate(size_t size) {
+#if defined(__GLIBC__)
+    return __libc_malloc(size);
+#else
+    return std::malloc(size);
+#endif
+}
+
+void* rawAllocateAligned(size_t size, size_t alignment) {
+#if defined(__GLIBC__)
+    return __libc_memalign(alignment, size);
+#elif JUCE_WINDOWS
+    return _aligned_malloc(size, alignment);
+#else
+    void* ptr = nullptr;
+    return posix_memalign(&ptr, alignment, size) == 0 ? ptr : nullptr;
+#endif
+}
+
+void rawFree(void* ptr) {
+#if defined(__GLIBC__)
+    __libc_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void rawFreeAligned(void* ptr) {
+#if JUCE_WINDOWS
+    _aligned_free(ptr);
+#else
+    rawFree(ptr);
+#endif
+}
+
+void* allocate(size_t size) {
+    checkAllocation();
+    if (auto* ptr = rawAllocate(size != 0 ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void* allocateAligned(size_t size, std::align_val_t alignment) {
+    checkAllocation();
+    if (auto* ptr = rawAllocateAligned(size != 0 ? size : 1, (size_t)alignment))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void deallocate(void* ptr) {
+    if (ptr == nullptr) return;
+    checkAllocation();
+    rawFree(ptr);
+}
+
+void deallocateAligned(void* ptr) {
+    if (ptr == nullptr) return;
+    checkAllocation();
+    rawFreeAligned(ptr);
+}
+} // namespace
+
+ScopedNoAllocations::ScopedNoAllocations() { noAllocationDepth++; }
+
+ScopedNoAllocations::~ScopedNoAllocations() { noAllocationDepth--; }
+
+int ScopedNoAllocations::getNumViolations() { return numViolations.load(); }
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    checkAllocation();
+    return rawAllocate(size != 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    checkAllocation();
+    return rawAllocate(size != 0 ? size : 1);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return allocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return allocateAligned(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept { deallocate(ptr); }
+void operator delete[](void* ptr) noexcept { deallocate(ptr); }
+void operator delete(void* ptr, size_t) noexcept { deallocate(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { deallocate(ptr); }
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    deallocate(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    deallocateAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    deallocateAligned(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+    deallocateAligned(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+    deallocateAligned(ptr);
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+void* malloc(size_t size) {
+    checkAllocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    checkAllocation();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    checkAllocation();
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    if (ptr != nullptr) checkAllocation();
+    __libc_free(ptr);
+}
+}
+#endif
+
+#endif
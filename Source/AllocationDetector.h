@@ -0,0 +1,27 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Debug aid for keeping the audio thread allocation free. When
+// NOISAT_DETECT_AUDIO_ALLOCATIONS is enabled the global allocation functions
+// (operator new/delete everywhere, and the malloc family on glibc) assert if
+// they are called while a ScopedNoAllocations is alive on the calling thread.
+#ifndef NOISAT_DETECT_AUDIO_ALLOCATIONS
+#define NOISAT_DETECT_AUDIO_ALLOCATIONS 0
+#endif
+
+class ScopedNoAllocations {
+public:
+#if NOISAT_DETECT_AUDIO_ALLOCATIONS
+    ScopedNoAllocations();
+    ~ScopedNoAllocations();
+
+    // Allocations made inside a ScopedNoAllocations so far, on any thread.
+    static int getNumViolations();
+#else
+    ScopedNoAllocations() {}
+    static int getNumViolations() { return 0; }
+#endif
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedNoAllocations)
+};
@@ -1,24 +1,79 @@
 #include "ClippingCurve.h"
 
 ClippingCurve::ClippingCurve(NoisatAudioProcessor& audioProcessor)
-    : audioProcessor(audioProcessor) {
+    : audioProcessor(audioProcessor),
+      customAttch(*audioProcessor.clipper.custom, customButton) {
     audioProcessor.clipper.knee->addListener(this);
     audioProcessor.clipper.ratio->addListener(this);
     audioProcessor.clipper.threshold->addListener(this);
+    audioProcessor.clipper.custom->addListener(this);
+
+    for (auto& cp : controlPoints) {
+        cp.addListener(this);
+        addChildComponent(cp);
+    }
+
+    customButton.setButtonText("Custom");
+    customButton.setClickingTogglesState(true);
+    addAndMakeVisible(customButton);
+
+    updateControlPoints();
 }
 
-ClippingCurve::~ClippingCurve() {}
+ClippingCurve::~ClippingCurve() {
+    audioProcessor.clipper.knee->removeListener(this);
+    audioProcessor.clipper.ratio->removeListener(this);
+    audioProcessor.clipper.threshold->removeListener(this);
+    audioProcessor.clipper.custom->removeListener(this);
+
+    for (auto& cp : controlPoints) {
+        cp.removeListener(this);
+    }
+}
 
 void ClippingCurve::parameterValueChanged(int parameterIndex, float newValue) {
-    if (juce::MessageManager::getInstance()->isThisTheMessageThread()) {
-        cancelPendingUpdate();
-        handleAsyncUpdate();
-    } else {
-        triggerAsyncUpdate();
+    curveUpdate.trigger();
+}
+
+void ClippingCurve::refresh() {
+    updateControlPoints();
+    renderCurve();
+    repaint();
+}
+
+void ClippingCurve::resized() {
+    for (auto& cp : controlPoints) {
+        cp.setBounds(getLocalBounds().withTrimmedBottom(2));
     }
+
+    customButton.setBounds(
+        getLocalBounds().removeFromTop(20).removeFromRight(50).reduced(2)
+    );
+
+    renderCurve();
 }
 
-void ClippingCurve::handleAsyncUpdate() { repaint(); }
+void ClippingCurve::controlPointValueChanged(ControlPoint* cp) {
+    auto index = (size_t)std::distance(controlPoints.data(), cp);
+
+    audioProcessor.transferCurve.setControlPoint(
+        index,
+        { juce::jlimit(0.0f, 1.0f, cp->position.x),
+          juce::jlimit(0.0f, 1.0f, 1.0f - cp->position.y) }
+    );
+    curveUpdate.trigger();
+}
+
+void ClippingCurve::updateControlPoints() {
+    bool custom = audioProcessor.clipper.custom->get();
+
+    for (size_t i = 0; i < controlPoints.size(); i++) {
+        auto point = audioProcessor.transferCurve.getControlPoint(i);
+        controlPoints[i].setXValue(point.x);
+        controlPoints[i].setYValue(1.0f - point.y);
+        controlPoints[i].setVisible(custom);
+    }
+}
 
 void ClippingCurve::paint(juce::Graphics& g) {
     g.setColour(juce::Colour::fromRGB(0x66, 0x66, 0x66));
@@ -32,13 +87,43 @@ void ClippingCurve::paint(juce::Graphics& g) {
 
     g.fillAll(juce::Colour::fromRGB(0x11, 0x11, 0x11));
 
-    float height = (float)bounds.getHeight();
-    float width = (float)bounds.getWidth();
+    g.drawImage(curveImage, bounds.toFloat());
+}
+
+void ClippingCurve::renderCurve() {
+    auto bounds = getLocalBounds().withTrimmedBottom(2);
+    if (bounds.isEmpty()) return;
+
+    // Rendered at the physical resolution of the display.
+    auto scale = juce::Component::getApproximateScaleFactorForComponent(this);
+    auto imageBounds = (bounds.toFloat() * scale).getSmallestIntegerContainer();
+
+    if (curveImage.getBounds() != imageBounds.withZeroOrigin()) {
+        curveImage = juce::Image(
+            juce::Image::ARGB,
+            imageBounds.getWidth(),
+            imageBounds.getHeight(),
+            true
+        );
+    } else {
+        curveImage.clear(curveImage.getBounds());
+    }
+
+    float height = (float)curveImage.getHeight();
+    float width = (float)curveImage.getWidth();
+
+    curve.resize((size_t)curveImage.getWidth());
+    for (size_t i = 0; i < curve.size(); i++) {
+        curve[i] = (float)i / width;
+    }
+    audioProcessor.transferCurve.evaluate(
+        curve.data(), curve.data(), curve.size()
+    );
 
     juce::Path clipCurve;
-    for (int i = 0; i < bounds.getWidth(); i++) {
+    for (size_t i = 0; i < curve.size(); i++) {
         float x = (float)i;
-        float y = height - audioProcessor.clipper.evaluate(x / width) * height;
+        float y = height - curve[i] * height;
 
         if (i == 0) {
             clipCurve.startNewSubPath(x, y);
@@ -47,6 +132,7 @@ void ClippingCurve::paint(juce::Graphics& g) {
         }
     }
 
+    juce::Graphics g(curveImage);
     g.setColour(juce::Colour::fromRGB(0xe8, 0x5d, 0x00));
-    g.strokePath(clipCurve, juce::PathStrokeType(2.0f));
-}
\ No newline at end of file
+    g.strokePath(clipCurve, juce::PathStrokeType(2.0f * scale));
+}
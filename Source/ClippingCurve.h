@@ -1,11 +1,16 @@
 #pragma once
 
+#include "NoiseColorEditor.h"
 #include "PluginProcessor.h"
 #include <JuceHeader.h>
 
+// Draws the clipping transfer curve. The curve is rendered into a cached
+// image, which is redrawn when the size changes and, through the
+// UpdateScheduler, at most once per frame however fast the curve's parameters
+// are automated.
 class ClippingCurve : public juce::Component,
                       public juce::AudioProcessorParameter::Listener,
-                      public juce::AsyncUpdater {
+                      private ControlPointListener<ControlPoint> {
 public:
     ClippingCurve(NoisatAudioProcessor& audioProcessor);
     ~ClippingCurve();
@@ -14,10 +19,24 @@ public:
     void parameterGestureChanged(
         int parameterIndex, bool gestureIsStarting
     ) override {};
-    void handleAsyncUpdate() override;
 
     void paint(juce::Graphics& g) override;
+    void resized() override;
 
 private:
+    void controlPointValueChanged(ControlPoint* cp) override;
+    void updateControlPoints();
+    void refresh();
+    void renderCurve();
+
     NoisatAudioProcessor& audioProcessor;
+
+    std::array<ControlPoint, TransferCurve::numControlPoints> controlPoints;
+
+    juce::TextButton customButton;
+    juce::ButtonParameterAttachment customAttch;
+
+    std::vector<float> curve;
+    juce::Image curveImage;
+    ScheduledUpdate curveUpdate{ [this] { refresh(); } };
 };
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "Simd.h"
+#include "TransferTable.h"
+
+namespace noisat::core {
+
+// Constants derived from threshold, knee and ratio. Built once per block
+// (or per ramp step while smoothing) instead of once per sample.
+struct ClipShape {
+    ClipShape(float thresValue, float kneeValue, float ratioValue)
+        : threshold(thresValue), knee(kneeValue), ratio(ratioValue),
+          invRange(1.0f / std::max(1.0f - thresValue, 1.0e-6f)),
+          outScale((1.0f - thresValue) / ratioValue) {}
+
+    float threshold;
+    float knee;
+    float ratio;
+    float invRange;
+    float outScale;
+};
+
+// Settings for which the transfer curve simplifies. A hard knee skips the
+// exponential. With a ratio of 1 below a threshold of 1 the overshoot keeps
+// unit slope, and with both the curve is the identity.
+enum class Knee { soft, hard };
+enum class Ratio { any, unity };
+
+inline Knee getKnee(const ClipShape& shape) {
+    return shape.knee == 0.0f ? Knee::hard : Knee::soft;
+}
+inline Ratio getRatio(const ClipShape& shape) {
+    return shape.ratio == 1.0f && shape.threshold < 1.0f ? Ratio::unity
+                                                         : Ratio::any;
+}
+
+// exp(-y) for y >= 0, computed as exp(-y / 64)^64. The reduced argument stays
+// within [-1.36, 0] where a 6th order Taylor polynomial is accurate, and the
+// squarings only need multiplies so the same code runs on SIMD registers.
+// Relative error stays below 1e-5 for y < 20, beyond which the result is
+// negligible next to the clipping threshold anyway.
+template <typename T> T expNeg(T y) {
+    T u = minOf(y, broadcast<T>(87)) * (Element<T>)(-1.0 / 64.0);
+
+    T p = u * (Element<T>)(1.0 / 720.0) + (Element<T>)(1.0 / 120.0);
+    p = p * u + (Element<T>)(1.0 / 24.0);
+    p = p * u + (Element<T>)(1.0 / 6.0);
+    p = p * u + (Element<T>)0.5;
+    p = p * u + (Element<T>)1;
+    p = p * u + (Element<T>)1;
+
+    for (int i = 0; i < 6; i++) {
+        p = p * p;
+    }
+
+    return p;
+}
+
+// Transfer curve for the magnitude of a sample, specialised for `K` and `R`.
+// Below the threshold the second term is zero, so no select is needed to pass
+// the signal through.
+template <Knee K, Ratio R> struct ClipKernel {
+    template <typename T> struct Constants {
+        explicit Constants(const ClipShape& shape)
+            : threshold((T)shape.threshold),
+              slope((T)(shape.invRange * shape.outScale)),
+              kneeScale((T)(shape.invRange * shape.knee)) {}
+
+        T threshold;
+        T slope;
+        T kneeScale;
+    };
+
+    static constexpr bool isIdentity = K == Knee::hard && R == Ratio::unity;
+
+    template <typename V>
+    static V magnitude(V m, const Constants<Element<V>>& c) {
+        if constexpr (isIdentity) {
+            return m;
+        } else {
+            V over = maxOf(m - c.threshold, broadcast<V>(0));
+            V below = minOf(m, broadcast<V>(c.threshold));
+
+            if constexpr (K == Knee::hard) {
+                return below + over * c.slope;
+            } else if constexpr (R == Ratio::unity) {
+                return below + over * expNeg(over * c.kneeScale);
+            } else {
+                return below + over * expNeg(over * c.kneeScale) * c.slope;
+            }
+        }
+    }
+
+    template <typename V> static V apply(V x, const Constants<Element<V>>& c) {
+        return withSignOf(magnitude(absOf(x), c), x);
+    }
+
+    // Clips both polarities of `numSamples` samples. `in` and `out` may
+    // alias.
+    template <typename T>
+    static void process(
+        const ClipShape& shape, const T* in, T* out, size_t numSamples
+    ) {
+        if constexpr (isIdentity) {
+            if (in != out) std::copy(in, in + numSamples, out);
+        } else {
+            constexpr size_t width = Vec<T>::size;
+            Constants<T> c{ shape };
+
+            size_t i = 0;
+            for (; i + width <= numSamples; i += width) {
+                store(out + i, apply(load<Vec<T>>(in + i), c));
+            }
+            for (; i < numSamples; i++) {
+                out[i] = apply(in[i], c);
+            }
+        }
+    }
+};
+
+// Calls `function` with ClipKernel specialised for `shape`.
+template <typename Function>
+decltype(auto) withClipKernel(const ClipShape& shape, Function&& function) {
+    bool hard = getKnee(shape) == Knee::hard;
+    bool unity = getRatio(shape) == Ratio::unity;
+
+    if (hard && unity) return function(ClipKernel<Knee::hard, Ratio::unity>{});
+    if (hard) return function(ClipKernel<Knee::hard, Ratio::any>{});
+    if (unity) return function(ClipKernel<Knee::soft, Ratio::unity>{});
+    return function(ClipKernel<Knee::soft, Ratio::any>{});
+}
+
+template <typename T>
+void clip(const ClipShape& shape, const T* in, T* out, size_t numSamples) {
+    withClipKernel(shape, [&](auto kernel) {
+        decltype(kernel)::process(shape, in, out, numSamples);
+    });
+}
+
+} // namespace noisat::core
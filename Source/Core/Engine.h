@@ -0,0 +1,379 @@
+#pragma once
+
+#include "Clipper.h"
+#include "NoiseFilter.h"
+#include "NoiseGenerator.h"
+#include "TransferTable.h"
+
+#include <array>
+#include <cassert>
+#include <tuple>
+#include <vector>
+
+namespace noisat::core {
+
+// Plain copy of every parameter the engine needs, taken once per block.
+struct Parameters {
+    float noiseThreshold = 0.5f;
+    float noiseCorrelation = 0.0f;
+    NoiseFilterSettings noiseFilter;
+
+    float preGain = 1.0f;
+    float postGain = 1.0f;
+    float dryWet = 1.0f;
+
+    float clipThres = 1.0f;
+    float clipKnee = 1.0f;
+    float clipRatio = 1.0f;
+
+    ClipShape getClipShape() const {
+        return { clipThres, clipKnee, clipRatio };
+    }
+};
+
+// Per-sample values of the gains, the mix and the clipping shape for a block,
+// for when any of them is moving.
+template <typename T> struct Ramps {
+    const T* preGain;
+    const T* postGain;
+    const T* dryWet;
+    const T* clipThres;
+    const T* clipKnee;
+    const T* clipRatio;
+};
+
+// Settings for which the mix simplifies. A mix of 1 passes the gained input
+// through, so nothing needs to be clipped, and a mix of 0 only the clipped
+// signal. Noise is off when the engine is given none, or when the curve never
+// moves a sample, so that there is nothing to scale it by.
+enum class Mix { blend, wet, dry };
+enum class Noise { on, off };
+
+inline Mix getMix(float dryWet) {
+    if (dryWet == 1.0f) return Mix::dry;
+    if (dryWet == 0.0f) return Mix::wet;
+    return Mix::blend;
+}
+
+// Clips, adds noise and mixes at whatever rate it is prepared for, usually
+// the oversampled one. The clip, noise and mix stages are fused into a single
+// pass, compiled separately for each combination of the simplifications in
+// ClipKernel, Mix and Noise, and picked once per block from the parameters.
+// Blocks where a parameter is still moving, or that are clipped with a
+// transfer table, take a general path that works stage by stage instead.
+class Engine {
+public:
+    void prepare(
+        double sampleRate, int channels, int maxBlockSize, bool doublePrecision,
+        const Parameters& initial
+    ) {
+        numChannels = channels;
+
+        filter.prepare(sampleRate, channels, maxBlockSize, initial.noiseFilter);
+        generator.prepare(channels, maxBlockSize);
+        nextPosition = 0;
+
+        // Only the general path needs scratch space, and only for the
+        // precision in use.
+        auto floatSize = doublePrecision ? 0 : (size_t)maxBlockSize;
+        auto doubleSize = doublePrecision ? (size_t)maxBlockSize : 0;
+        for (auto& buffer : std::get<ScratchBuffers<float>>(scratch)) {
+            buffer.assign(floatSize, 0.0f);
+        }
+        for (auto& buffer : std::get<ScratchBuffers<double>>(scratch)) {
+            buffer.assign(doubleSize, 0.0);
+        }
+    }
+
+    void setSeed(uint64_t seed) { generator.setSeed(seed); }
+
+    // Must be called once per block, before renderNoise() and process().
+    void beginBlock(int numSamples, const Parameters& params) {
+        filter.beginBlock((size_t)numSamples, params.noiseFilter);
+    }
+
+    // Whether process() would add any noise. If not, rendering the noise can
+    // be skipped and process() be given none.
+    static bool
+    needsNoise(const Parameters& params, bool isRamping, bool usesTable) {
+        if (isRamping) return true;
+        if (getMix(params.dryWet) == Mix::dry) return false;
+        if (usesTable) return true;
+
+        auto shape = params.getClipShape();
+        return getKnee(shape) == Knee::soft || getRatio(shape) == Ratio::any;
+    }
+
+    // Fills one buffer per channel with filtered white noise, from sample
+    // `position` of the noise streams on.
+    //
+    // The filter state only carries over from a block that ended right where
+    // this one starts. After a gap it starts from silence, so that it only
+    // depends on the noise rendered since, and not on how long ago the noise
+    // was last needed.
+    template <typename T>
+    void renderNoise(
+        T* const* noise, int numSamples, const Parameters& params,
+        uint64_t position
+    ) {
+        if (position != nextPosition) filter.reset();
+        nextPosition = position + (uint64_t)numSamples;
+
+        generator.setCorrelation(params.noiseCorrelation);
+        generator.generate(noise, numSamples, position);
+        filter.process(noise, (size_t)numChannels, (size_t)numSamples);
+    }
+
+    // Processes `numSamples` samples of every channel in place. `noise` may
+    // be null if needsNoise() said so. `ramps` replaces the constant gains,
+    // mix and shape of `params`, and `table` the built-in curve.
+    template <typename T>
+    void process(
+        T* const* channels, const T* const* noise, int numSamples,
+        const Parameters& params, const Ramps<T>* ramps = nullptr,
+        const TransferTable* table = nullptr
+    ) {
+        auto n = (size_t)numSamples;
+
+        // A fully dry mix ignores the curve, so even a table can be skipped.
+        bool usesTable = table != nullptr && getMix(params.dryWet) != Mix::dry;
+
+        if (ramps != nullptr || usesTable) {
+            for (int channel = 0; channel < numChannels; channel++) {
+                processStages(
+                    channels[channel],
+                    noise != nullptr ? noise[channel] : nullptr,
+                    n,
+                    params,
+                    ramps,
+                    table
+                );
+            }
+            return;
+        }
+
+        bool hasNoise = noise != nullptr;
+        withKernel(params, hasNoise, [&](auto clip, auto mix, auto mode) {
+            using Clip = decltype(clip);
+            constexpr Mix M = decltype(mix)::value;
+            constexpr Noise N = decltype(mode)::value;
+
+            FusedConstants<T, Clip> c{ params };
+            for (int channel = 0; channel < numChannels; channel++) {
+                processFused<Clip, M, N>(
+                    c,
+                    channels[channel],
+                    N == Noise::on ? noise[channel] : nullptr,
+                    n
+                );
+            }
+        });
+    }
+
+private:
+    template <typename T> using ScratchBuffers = std::array<std::vector<T>, 2>;
+
+    template <typename T, typename Clip> struct FusedConstants {
+        explicit FusedConstants(const Parameters& params)
+            : clip(params.getClipShape()), preGain((T)params.preGain),
+              postGain((T)params.postGain),
+              dryGain((T)(params.dryWet * params.postGain)),
+              wetGain((T)((1.0f - params.dryWet) * params.postGain)),
+              passGain((T)(params.preGain * params.postGain)),
+              noiseThreshold((T)params.noiseThreshold) {}
+
+        typename Clip::template Constants<T> clip;
+        T preGain;
+        T postGain;
+        T dryGain;
+        T wetGain;
+        T passGain;
+        T noiseThreshold;
+    };
+
+    // Calls `function` with the clip kernel, mix and noise mode for
+    // `params`, the latter two as std::integral_constant.
+    template <typename Function>
+    static void
+    withKernel(const Parameters& params, bool hasNoise, Function&& function) {
+        using Dry = std::integral_constant<Mix, Mix::dry>;
+        using Wet = std::integral_constant<Mix, Mix::wet>;
+        using Blend = std::integral_constant<Mix, Mix::blend>;
+        using NoiseOn = std::integral_constant<Noise, Noise::on>;
+        using NoiseOff = std::integral_constant<Noise, Noise::off>;
+
+        auto mix = getMix(params.dryWet);
+
+        // Fully dry output never looks at the curve or the noise.
+        if (mix == Mix::dry) {
+            function(ClipKernel<Knee::hard, Ratio::unity>{}, Dry{}, NoiseOff{});
+            return;
+        }
+
+        withClipKernel(params.getClipShape(), [&](auto clip) {
+            bool noise = hasNoise && !decltype(clip)::isIdentity;
+
+            if (mix == Mix::wet && noise) {
+                function(clip, Wet{}, NoiseOn{});
+            } else if (mix == Mix::wet) {
+                function(clip, Wet{}, NoiseOff{});
+            } else if (noise) {
+                function(clip, Blend{}, NoiseOn{});
+            } else {
+                function(clip, Blend{}, NoiseOff{});
+            }
+        });
+    }
+
+    // Adds noise scaled by how far the clipper went past the noise
+    // threshold.
+    template <typename V>
+    static V addNoise(V gained, V clipped, V noise, Element<V> threshold) {
+        V excess =
+            maxOf(absOf(clipped - gained) - threshold, broadcast<V>(0));
+        return clipped + withSignOf(excess, clipped) * noise;
+    }
+
+    template <typename Clip, Mix M, Noise N, typename V>
+    static V
+    processSample(V x, V noise, const FusedConstants<Element<V>, Clip>& c) {
+        if constexpr (M == Mix::dry) {
+            return x * c.passGain;
+        } else {
+            V gained = x * c.preGain;
+            V output = Clip::apply(gained, c.clip);
+
+            if constexpr (N == Noise::on) {
+                output = addNoise(gained, output, noise, c.noiseThreshold);
+            }
+
+            if constexpr (M == Mix::wet) {
+                return output * c.postGain;
+            } else {
+                return gained * c.dryGain + output * c.wetGain;
+            }
+        }
+    }
+
+    template <typename Clip, Mix M, Noise N, typename T>
+    static void processFused(
+        const FusedConstants<T, Clip>& c, T* samples, const T* noise,
+        size_t numSamples
+    ) {
+        constexpr size_t width = Vec<T>::size;
+
+        auto noiseAt = [noise](size_t i, auto zero) {
+            using V = decltype(zero);
+            if constexpr (N == Noise::on) {
+                return load<V>(noise + i);
+            } else {
+                return zero;
+            }
+        };
+
+        size_t i = 0;
+        for (; i + width <= numSamples; i += width) {
+            auto x = load<Vec<T>>(samples + i);
+            auto n = noiseAt(i, Vec<T>::broadcast(0));
+            store(samples + i, processSample<Clip, M, N>(x, n, c));
+        }
+        for (; i < numSamples; i++) {
+            auto n = noiseAt(i, T{});
+            samples[i] = processSample<Clip, M, N>(samples[i], n, c);
+        }
+    }
+
+    // General path: gain, clip and mix in separate passes, with any of the
+    // parameters optionally ramping.
+    template <typename T>
+    void processStages(
+        T* samples, const T* noise, size_t numSamples, const Parameters& params,
+        const Ramps<T>* ramps, const TransferTable* table
+    ) {
+        // While threshold, knee or ratio are ramping the clipper shape is
+        // stepped at this interval instead of being rebuilt for every sample.
+        constexpr size_t shapeStep = 16;
+        constexpr size_t width = Vec<T>::size;
+
+        auto& buffers = std::get<ScratchBuffers<T>>(scratch);
+        assert(numSamples <= buffers[0].size());
+        auto* gained = buffers[0].data();
+        auto* clipped = buffers[1].data();
+
+        auto valueAt = [ramps](const T* ramp, float constant, size_t i) {
+            return ramps != nullptr ? ramp[i] : (T)constant;
+        };
+        auto vectorAt = [ramps](const T* ramp, float constant, size_t i) {
+            return ramps != nullptr ? Vec<T>::load(ramp + i)
+                                    : Vec<T>::broadcast((T)constant);
+        };
+
+        const T* preRamp = ramps != nullptr ? ramps->preGain : nullptr;
+        const T* postRamp = ramps != nullptr ? ramps->postGain : nullptr;
+        const T* mixRamp = ramps != nullptr ? ramps->dryWet : nullptr;
+
+        for (size_t i = 0; i < numSamples; i++) {
+            gained[i] = samples[i] * valueAt(preRamp, params.preGain, i);
+        }
+
+        if (table != nullptr) {
+            table->process(gained, clipped, numSamples);
+        } else if (ramps != nullptr) {
+            for (size_t i = 0; i < numSamples; i += shapeStep) {
+                ClipShape shape{
+                    (float)ramps->clipThres[i],
+                    (float)ramps->clipKnee[i],
+                    (float)ramps->clipRatio[i],
+                };
+                clip(
+                    shape,
+                    gained + i,
+                    clipped + i,
+                    std::min(shapeStep, numSamples - i)
+                );
+            }
+        } else {
+            clip(params.getClipShape(), gained, clipped, numSamples);
+        }
+
+        auto mixSample = [&](auto g, auto c, auto n, auto dryWet, auto post) {
+            auto output = noise != nullptr
+                ? addNoise(g, c, n, (T)params.noiseThreshold)
+                : c;
+            return (g * dryWet + (1 - dryWet) * output) * post;
+        };
+
+        size_t i = 0;
+        for (; i + width <= numSamples; i += width) {
+            auto n = noise != nullptr ? Vec<T>::load(noise + i)
+                                      : Vec<T>::broadcast(0);
+            auto output = mixSample(
+                Vec<T>::load(gained + i),
+                Vec<T>::load(clipped + i),
+                n,
+                vectorAt(mixRamp, params.dryWet, i),
+                vectorAt(postRamp, params.postGain, i)
+            );
+            output.store(samples + i);
+        }
+        for (; i < numSamples; i++) {
+            samples[i] = mixSample(
+                gained[i],
+                clipped[i],
+                noise != nullptr ? noise[i] : T{},
+                valueAt(mixRamp, params.dryWet, i),
+                valueAt(postRamp, params.postGain, i)
+            );
+        }
+    }
+
+    int numChannels = 0;
+    uint64_t nextPosition = 0;
+
+    NoiseGenerator generator;
+    NoiseFilter filter;
+
+    std::tuple<ScratchBuffers<float>, ScratchBuffers<double>> scratch;
+};
+
+} // namespace noisat::core
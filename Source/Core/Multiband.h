@@ -0,0 +1,458 @@
+#pragma once
+
+#include "Engine.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <tuple>
+#include <vector>
+
+namespace noisat::core {
+
+constexpr int maxBands = 4;
+
+// Clipping shape and noise threshold of one band, as in Parameters.
+struct BandSettings {
+    float clipThres = 1.0f;
+    float clipKnee = 1.0f;
+    float clipRatio = 1.0f;
+    float noiseThreshold = 0.5f;
+};
+
+struct MultibandSettings {
+    // A single band turns the multiband mode off.
+    int numBands = 1;
+    std::array<float, maxBands - 1> crossovers{ 120.0f, 1000.0f, 6000.0f };
+    std::array<BandSettings, maxBands> bands;
+
+    bool isEnabled() const { return numBands > 1; }
+};
+
+// Per-sample values of the band settings and the crossover frequencies for a
+// block, for when any of them is moving, like Ramps.
+template <typename T> struct BandRamps {
+    std::array<const T*, maxBands> clipThres;
+    std::array<const T*, maxBands> clipKnee;
+    std::array<const T*, maxBands> clipRatio;
+    std::array<const T*, maxBands> noiseThreshold;
+    std::array<const T*, maxBands - 1> crossovers;
+};
+
+// The value of every band for one sample, in as many registers as it takes
+// at precision `T`, with the register operations the multiband kernel uses.
+template <typename T> struct BandLanes {
+    static constexpr size_t width = Vec<T>::size;
+    static constexpr size_t numRegisters = (size_t)maxBands / width;
+    std::array<Vec<T>, numRegisters> registers;
+
+    static BandLanes load(const T* data) {
+        BandLanes lanes;
+        for (size_t r = 0; r < numRegisters; r++) {
+            lanes.registers[r] = Vec<T>::load(data + r * width);
+        }
+        return lanes;
+    }
+    static BandLanes broadcast(T x) {
+        BandLanes lanes;
+        lanes.registers.fill(Vec<T>::broadcast(x));
+        return lanes;
+    }
+
+    T sum() const {
+        alignas(16) std::array<T, (size_t)maxBands> values;
+        for (size_t r = 0; r < numRegisters; r++) {
+            registers[r].store(values.data() + r * width);
+        }
+
+        T total = 0;
+        for (auto value : values) {
+            total += value;
+        }
+        return total;
+    }
+
+    template <typename Op>
+    friend BandLanes apply(BandLanes a, BandLanes b, Op op) {
+        BandLanes lanes;
+        for (size_t r = 0; r < numRegisters; r++) {
+            lanes.registers[r] = op(a.registers[r], b.registers[r]);
+        }
+        return lanes;
+    }
+
+    friend BandLanes operator+(BandLanes a, BandLanes b) {
+        return apply(a, b, [](Vec<T> x, Vec<T> y) { return x + y; });
+    }
+    friend BandLanes operator-(BandLanes a, BandLanes b) {
+        return apply(a, b, [](Vec<T> x, Vec<T> y) { return x - y; });
+    }
+    friend BandLanes operator*(BandLanes a, BandLanes b) {
+        return apply(a, b, [](Vec<T> x, Vec<T> y) { return x * y; });
+    }
+    friend BandLanes operator+(BandLanes a, T b) { return a + broadcast(b); }
+    friend BandLanes operator*(BandLanes a, T b) { return a * broadcast(b); }
+    friend BandLanes minOf(BandLanes a, BandLanes b) {
+        return apply(a, b, [](Vec<T> x, Vec<T> y) { return minOf(x, y); });
+    }
+    friend BandLanes maxOf(BandLanes a, BandLanes b) {
+        return apply(a, b, [](Vec<T> x, Vec<T> y) { return maxOf(x, y); });
+    }
+    friend BandLanes absOf(BandLanes a) {
+        return apply(a, a, [](Vec<T> x, Vec<T>) { return absOf(x); });
+    }
+    friend BandLanes withSignOf(BandLanes magnitude, BandLanes sign) {
+        return apply(magnitude, sign, [](Vec<T> x, Vec<T> y) {
+            return withSignOf(x, y);
+        });
+    }
+};
+
+template <typename T> struct ElementOf<BandLanes<T>> {
+    using Type = T;
+};
+
+// Splits the signal into up to four bands with a fourth order Linkwitz-Riley
+// crossover, clips each band and adds noise to it with settings of its own,
+// and sums the bands back up.
+//
+// Every band lives in its own lane of one SIMD register, so all of them are
+// filtered and clipped by the same instructions: clipping four bands costs
+// the same as clipping two, and each crossover frequency adds two filter
+// stages however many bands there are. To make that work, each band is
+// computed straight from the input by a chain of identical filter stages
+// rather than by a tree of splits: at every crossover frequency a band takes
+// the lowpass, the highpass or, for the bands below it, the allpass that
+// matches the phase of the other two. Each stage is a state variable filter
+// whose output mix picks the response per lane. The coefficients and states
+// are kept as one array per quantity, with a register per stage holding the
+// values of all bands.
+//
+// The bands only add up to the input passed through the allpasses, so the
+// dry signal is taken from the unclipped bands, too. Otherwise a blend would
+// notch wherever the allpasses turn the phase around.
+//
+// Lanes run at the host precision: in double precision the bands take two
+// registers. The mix and the gains follow their ramps sample by sample. The
+// band settings and crossover frequencies follow theirs in steps, like the
+// clipping shape of Engine, with the coefficients rebuilt for every step.
+class MultibandClipper {
+public:
+    // Two second order stages per crossover frequency.
+    static constexpr int maxStages = 2 * (maxBands - 1);
+
+    void prepare(double rate, int numChannels) {
+        sampleRate = rate;
+        std::get<0>(states).assign((size_t)numChannels, {});
+        std::get<1>(states).assign((size_t)numChannels, {});
+    }
+
+    void reset() {
+        auto& single = std::get<0>(states);
+        auto& twice = std::get<1>(states);
+        std::fill(single.begin(), single.end(), State<float>{});
+        std::fill(twice.begin(), twice.end(), State<double>{});
+    }
+
+    // Whether process() would add any noise.
+    static bool needsNoise(const Parameters& params, bool isRamping) {
+        return isRamping || getMix(params.dryWet) != Mix::dry;
+    }
+
+    // Must be called once per block, before process(). Changing the number
+    // of bands starts them from silence.
+    void beginBlock(const MultibandSettings& settings) {
+        blockSettings = settings;
+        auto numBands = std::clamp(settings.numBands, 1, maxBands);
+        if (numBands != activeBands) reset();
+        activeBands = numBands;
+        numStages = 2 * (numBands - 1);
+
+        setUp(std::get<0>(kernels), settings);
+        setUp(std::get<1>(kernels), settings);
+    }
+
+    // Processes `numSamples` samples of every channel in place, like
+    // Engine::process(). The clipping settings of `params` are replaced by
+    // those of the bands, and `bandRamps` replaces those in turn.
+    template <typename T>
+    void process(
+        T* const* channels, const T* const* noise, int numSamples,
+        const Parameters& params, const Ramps<T>* ramps = nullptr,
+        const BandRamps<T>* bandRamps = nullptr
+    ) {
+        if (bandRamps == nullptr) {
+            processStep(channels, noise, 0, numSamples, params, ramps);
+            return;
+        }
+
+        // Each step is processed for every channel with the same kernel,
+        // which is only rebuilt where the settings moved.
+        auto& kernel = std::get<Kernel<T>>(kernels);
+        auto stepSettings = blockSettings;
+        auto kernelSettings = blockSettings;
+
+        for (int start = 0; start < numSamples; start += settingsStep) {
+            auto i = (size_t)start;
+            for (size_t band = 0; band < (size_t)maxBands; band++) {
+                auto& s = stepSettings.bands[band];
+                s.clipThres = (float)bandRamps->clipThres[band][i];
+                s.clipKnee = (float)bandRamps->clipKnee[band][i];
+                s.clipRatio = (float)bandRamps->clipRatio[band][i];
+                s.noiseThreshold = (float)bandRamps->noiseThreshold[band][i];
+            }
+            for (size_t split = 0; split < (size_t)maxBands - 1; split++) {
+                stepSettings.crossovers[split] =
+                    (float)bandRamps->crossovers[split][i];
+            }
+            if (start == 0 || !isSameShape(stepSettings, kernelSettings)) {
+                setUp(kernel, stepSettings);
+                kernelSettings = stepSettings;
+            }
+
+            auto length = std::min(settingsStep, numSamples - start);
+            processStep(channels, noise, start, length, params, ramps);
+        }
+    }
+
+private:
+    template <typename T> using Lanes = BandLanes<T>;
+
+    // While the band settings or crossovers are ramping, the coefficients
+    // are stepped at this interval instead of being rebuilt for every
+    // sample.
+    static constexpr int settingsStep = 16;
+
+    // Filter coefficients of every stage, and the weights of the stage input
+    // and of its band- and lowpass outputs in what it passes on, followed by
+    // the clipping and noise settings of every band.
+    template <typename T> struct Kernel {
+        std::array<Lanes<T>, maxStages> a1;
+        std::array<Lanes<T>, maxStages> a2;
+        std::array<Lanes<T>, maxStages> a3;
+        std::array<Lanes<T>, maxStages> input;
+        std::array<Lanes<T>, maxStages> band;
+        std::array<Lanes<T>, maxStages> low;
+
+        Lanes<T> clipThres;
+        Lanes<T> clipSlope;
+        Lanes<T> clipKneeScale;
+        Lanes<T> noiseThreshold;
+    };
+
+    template <typename T> struct State {
+        std::array<Lanes<T>, maxStages> ic1{};
+        std::array<Lanes<T>, maxStages> ic2{};
+    };
+
+    template <typename T>
+    void setUp(Kernel<T>& kernel, const MultibandSettings& settings) const {
+        setCrossovers(kernel, settings);
+
+        std::array<T, maxBands> thres{}, slope{}, kneeScale{}, noise{};
+        for (size_t band = 0; band < (size_t)maxBands; band++) {
+            const auto& s = settings.bands[band];
+            ClipShape shape{ s.clipThres, s.clipKnee, s.clipRatio };
+
+            thres[band] = (T)shape.threshold;
+            slope[band] = (T)(shape.invRange * shape.outScale);
+            kneeScale[band] = (T)(shape.invRange * shape.knee);
+            noise[band] = (T)s.noiseThreshold;
+        }
+        kernel.clipThres = Lanes<T>::load(thres.data());
+        kernel.clipSlope = Lanes<T>::load(slope.data());
+        kernel.clipKneeScale = Lanes<T>::load(kneeScale.data());
+        kernel.noiseThreshold = Lanes<T>::load(noise.data());
+    }
+
+    template <typename T>
+    void setCrossovers(
+        Kernel<T>& kernel, const MultibandSettings& settings
+    ) const {
+        auto frequencies = settings.crossovers;
+        auto numCrossovers = (size_t)activeBands - 1;
+
+        // The crossovers may be set in any order.
+        for (size_t i = 1; i < numCrossovers; i++) {
+            auto j = i;
+            for (; j > 0 && frequencies[j] < frequencies[j - 1]; j--) {
+                std::swap(frequencies[j], frequencies[j - 1]);
+            }
+        }
+
+        // A Butterworth pair sums to an allpass when squared, which is what
+        // makes the bands add back up to a flat response.
+        constexpr double k = 1.4142135623730951;
+        constexpr size_t numLanes = (size_t)maxBands;
+
+        for (size_t split = 0; split < numCrossovers; split++) {
+            auto svf = SvfCoefficients::make(
+                sampleRate, frequencies[split], 1.0 / k
+            );
+
+            for (size_t step = 0; step < 2; step++) {
+                std::array<T, numLanes> input{}, band{}, low{};
+                for (size_t lane = 0; lane < (size_t)activeBands; lane++) {
+                    if (lane < split && step == 0) {
+                        input[lane] = 1;
+                        band[lane] = (T)(-2.0 * k);
+                    } else if (lane < split) {
+                        input[lane] = 1;
+                    } else if (lane == split) {
+                        low[lane] = 1;
+                    } else {
+                        input[lane] = 1;
+                        band[lane] = (T)-k;
+                        low[lane] = -1;
+                    }
+                }
+
+                auto stage = 2 * split + step;
+                kernel.a1[stage] = Lanes<T>::broadcast((T)svf.a1);
+                kernel.a2[stage] = Lanes<T>::broadcast((T)svf.a2);
+                kernel.a3[stage] = Lanes<T>::broadcast((T)svf.a3);
+                kernel.input[stage] = Lanes<T>::load(input.data());
+                kernel.band[stage] = Lanes<T>::load(band.data());
+                kernel.low[stage] = Lanes<T>::load(low.data());
+            }
+        }
+    }
+
+    static bool
+    isSameShape(const MultibandSettings& a, const MultibandSettings& b) {
+        for (size_t band = 0; band < (size_t)maxBands; band++) {
+            const auto& x = a.bands[band];
+            const auto& y = b.bands[band];
+            if (x.clipThres != y.clipThres || x.clipKnee != y.clipKnee
+                || x.clipRatio != y.clipRatio
+                || x.noiseThreshold != y.noiseThreshold) {
+                return false;
+            }
+        }
+        return a.crossovers == b.crossovers;
+    }
+
+    // Processes `length` samples of every channel from `start` on, with
+    // the kernel as it is.
+    template <typename T>
+    void processStep(
+        T* const* channels, const T* const* noise, int start, int length,
+        const Parameters& params, const Ramps<T>* ramps
+    ) {
+        auto& channelStates = std::get<std::vector<State<T>>>(states);
+        const auto& kernel = std::get<Kernel<T>>(kernels);
+
+        Ramps<T> stepRamps;
+        if (ramps != nullptr) {
+            stepRamps = *ramps;
+            stepRamps.preGain += start;
+            stepRamps.postGain += start;
+            stepRamps.dryWet += start;
+        }
+
+        for (size_t channel = 0; channel < channelStates.size(); channel++) {
+            auto* samples = channels[channel] + start;
+            const T* channelNoise =
+                noise != nullptr ? noise[channel] + start : nullptr;
+            auto& state = channelStates[channel];
+
+            withStageCount([&](auto stages) {
+                processChannel<decltype(stages)::value>(
+                    kernel,
+                    state,
+                    samples,
+                    channelNoise,
+                    length,
+                    params,
+                    ramps != nullptr ? &stepRamps : nullptr
+                );
+            });
+        }
+    }
+
+    // Calls `function` with the number of active stages as a
+    // std::integral_constant, so that the stage loop can be unrolled.
+    template <typename Function> void withStageCount(Function&& function) {
+        switch (numStages) {
+        case 2:
+            function(std::integral_constant<int, 2>{});
+            break;
+        case 4:
+            function(std::integral_constant<int, 4>{});
+            break;
+        case 6:
+            function(std::integral_constant<int, 6>{});
+            break;
+        default:
+            break;
+        }
+    }
+
+    template <int NumStages, typename T>
+    static void processChannel(
+        const Kernel<T>& c, State<T>& state, T* samples, const T* noise,
+        int numSamples, const Parameters& params, const Ramps<T>* ramps
+    ) {
+        auto zero = Lanes<T>::broadcast(0);
+
+        auto valueAt = [ramps](const T* ramp, float constant, int i) {
+            return ramps != nullptr ? ramp[i] : (T)constant;
+        };
+        const T* preRamp = ramps != nullptr ? ramps->preGain : nullptr;
+        const T* postRamp = ramps != nullptr ? ramps->postGain : nullptr;
+        const T* mixRamp = ramps != nullptr ? ramps->dryWet : nullptr;
+
+        // The states stay in registers for the whole block.
+        auto ic1 = state.ic1;
+        auto ic2 = state.ic2;
+
+        for (int i = 0; i < numSamples; i++) {
+            T pre = valueAt(preRamp, params.preGain, i);
+            T gained = samples[i] * pre;
+
+            auto x = Lanes<T>::broadcast(gained);
+            for (int s = 0; s < NumStages; s++) {
+                auto v3 = x - ic2[s];
+                auto v1 = ic1[s] * c.a1[s] + v3 * c.a2[s];
+                auto v2 = ic2[s] + ic1[s] * c.a2[s] + v3 * c.a3[s];
+                ic1[s] = v1 * (T)2 - ic1[s];
+                ic2[s] = v2 * (T)2 - ic2[s];
+
+                x = x * c.input[s] + v1 * c.band[s] + v2 * c.low[s];
+            }
+
+            // The soft knee curve of ClipKernel, which reduces to the hard
+            // knee where the knee scale is zero and to unit slope where the
+            // ratio is one.
+            auto m = absOf(x);
+            auto over = maxOf(m - c.clipThres, zero);
+            auto below = minOf(m, c.clipThres);
+            auto clipped = withSignOf(
+                below + over * expNeg(over * c.clipKneeScale) * c.clipSlope, x
+            );
+
+            auto excess = maxOf(absOf(clipped - x) - c.noiseThreshold, zero);
+            T n = noise != nullptr ? noise[i] : (T)0;
+            clipped = clipped + withSignOf(excess, clipped) * n;
+
+            // Mixed per band, which leaves a single sum across the lanes.
+            T dryWet = valueAt(mixRamp, params.dryWet, i);
+            T post = valueAt(postRamp, params.postGain, i);
+            auto mixed = x * dryWet + clipped * ((T)1 - dryWet);
+            samples[i] = mixed.sum() * post;
+        }
+
+        state.ic1 = ic1;
+        state.ic2 = ic2;
+    }
+
+    double sampleRate = 44100.0;
+    MultibandSettings blockSettings;
+    int activeBands = 1;
+    int numStages = 0;
+
+    std::tuple<Kernel<float>, Kernel<double>> kernels{};
+    std::tuple<std::vector<State<float>>, std::vector<State<double>>> states;
+};
+
+} // namespace noisat::core
@@ -0,0 +1,463 @@
+#pragma once
+
+#include "Simd.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <vector>
+
+namespace noisat::core {
+
+constexpr double pi = 3.14159265358979323846;
+
+// Normalised angular frequency, kept below Nyquist.
+inline double getWarpedFrequency(double sampleRate, double frequency) {
+    return pi * std::min(frequency, sampleRate * 0.49) / sampleRate;
+}
+
+// Second order section coefficients, normalised so that a0 == 1. The noise
+// filters run as state variable filters, but their response is identical to
+// these bilinear transform biquads, which are cheaper to evaluate for drawing
+// and for rendering the noise table.
+struct BiquadCoefficients {
+    float b0 = 1.0f;
+    float b1 = 0.0f;
+    float b2 = 0.0f;
+    float a1 = 0.0f;
+    float a2 = 0.0f;
+
+    static BiquadCoefficients
+    makeHighPass(double sampleRate, double frequency, double q) {
+        auto n = std::tan(getWarpedFrequency(sampleRate, frequency));
+        auto nSquared = n * n;
+        auto invQ = 1.0 / q;
+        auto c1 = 1.0 / (1.0 + invQ * n + nSquared);
+
+        BiquadCoefficients c;
+        c.b0 = (float)c1;
+        c.b1 = (float)(c1 * -2.0);
+        c.b2 = (float)c1;
+        c.a1 = (float)(c1 * 2.0 * (nSquared - 1.0));
+        c.a2 = (float)(c1 * (1.0 - invQ * n + nSquared));
+        return c;
+    }
+
+    static BiquadCoefficients
+    makeLowPass(double sampleRate, double frequency, double q) {
+        auto n = 1.0 / std::tan(getWarpedFrequency(sampleRate, frequency));
+        auto nSquared = n * n;
+        auto invQ = 1.0 / q;
+        auto c1 = 1.0 / (1.0 + invQ * n + nSquared);
+
+        BiquadCoefficients c;
+        c.b0 = (float)c1;
+        c.b1 = (float)(c1 * 2.0);
+        c.b2 = (float)c1;
+        c.a1 = (float)(c1 * 2.0 * (1.0 - nSquared));
+        c.a2 = (float)(c1 * (1.0 - invQ * n + nSquared));
+        return c;
+    }
+
+    double getMagnitude(double frequency, double sampleRate) const {
+        auto w = 2.0 * pi * frequency / sampleRate;
+        auto cos1 = std::cos(w), sin1 = std::sin(w);
+        auto cos2 = std::cos(2.0 * w), sin2 = std::sin(2.0 * w);
+
+        auto numRe = b0 + b1 * cos1 + b2 * cos2;
+        auto numIm = b1 * sin1 + b2 * sin2;
+        auto denRe = 1.0 + a1 * cos1 + a2 * cos2;
+        auto denIm = a1 * sin1 + a2 * sin2;
+
+        return std::sqrt(
+            (numRe * numRe + numIm * numIm) / (denRe * denRe + denIm * denIm)
+        );
+    }
+};
+
+// Points on the unit circle for a fixed set of frequencies, so that
+// magnitude responses can be evaluated for all of them without trigonometry.
+struct FrequencyGrid {
+    void set(const double* frequencies, size_t numFrequencies, double rate) {
+        sampleRate = rate;
+        for (auto* values : { &cos1, &sin1, &cos2, &sin2 }) {
+            values->resize(numFrequencies);
+        }
+
+        for (size_t i = 0; i < numFrequencies; i++) {
+            auto w = 2.0 * pi * frequencies[i] / rate;
+            cos1[i] = std::cos(w);
+            sin1[i] = std::sin(w);
+            cos2[i] = std::cos(2.0 * w);
+            sin2[i] = std::sin(2.0 * w);
+        }
+    }
+
+    size_t size() const { return cos1.size(); }
+
+    double sampleRate = 0.0;
+    std::vector<double> cos1;
+    std::vector<double> sin1;
+    std::vector<double> cos2;
+    std::vector<double> sin2;
+};
+
+// Multiplies `power` by the squared magnitude response of `c` at every point
+// of `grid`, a SIMD register's worth of points at a time.
+inline void applyPowerResponse(
+    const BiquadCoefficients& c, const FrequencyGrid& grid, double* power
+) {
+    auto response = [&](auto cos1, auto sin1, auto cos2, auto sin2) {
+        auto numRe = cos1 * (double)c.b1 + cos2 * (double)c.b2 + (double)c.b0;
+        auto numIm = sin1 * (double)c.b1 + sin2 * (double)c.b2;
+        auto denRe = cos1 * (double)c.a1 + cos2 * (double)c.a2 + 1.0;
+        auto denIm = sin1 * (double)c.a1 + sin2 * (double)c.a2;
+
+        return (numRe * numRe + numIm * numIm)
+            / (denRe * denRe + denIm * denIm);
+    };
+
+    using V = Vec<double>;
+    auto n = grid.size();
+
+    size_t i = 0;
+    for (; i + V::size <= n; i += V::size) {
+        auto p = response(
+            V::load(grid.cos1.data() + i),
+            V::load(grid.sin1.data() + i),
+            V::load(grid.cos2.data() + i),
+            V::load(grid.sin2.data() + i)
+        );
+        (V::load(power + i) * p).store(power + i);
+    }
+    for (; i < n; i++) {
+        power[i] *=
+            response(grid.cos1[i], grid.sin1[i], grid.cos2[i], grid.sin2[i]);
+    }
+}
+
+// Coefficients of a trapezoidal (TPT) state variable filter section, see
+// Zavalishin, "The Art of VA Filter Design". Unlike a direct form biquad, its
+// state stays well conditioned for cutoffs far below the sample rate, which
+// matters for the highpass down at 4 Hz with 16x oversampling, and it copes
+// with coefficients changing every sample.
+struct SvfCoefficients {
+    double k = 0.0;
+    double a1 = 0.0;
+    double a2 = 0.0;
+    double a3 = 0.0;
+
+    static SvfCoefficients make(double sampleRate, double frequency, double q) {
+        auto g = std::tan(getWarpedFrequency(sampleRate, frequency));
+
+        SvfCoefficients c;
+        c.k = 1.0 / q;
+        c.a1 = 1.0 / (1.0 + g * (g + c.k));
+        c.a2 = g * c.a1;
+        c.a3 = g * c.a2;
+        return c;
+    }
+};
+
+// Exponential ramp towards a target over a fixed number of steps, matching
+// juce::SmoothedValue<float, ValueSmoothingTypes::Multiplicative>.
+class MultiplicativeSmoother {
+public:
+    void reset(double sampleRate, double rampLengthSeconds) {
+        stepsToTarget = (int)std::floor(rampLengthSeconds * sampleRate);
+        setCurrentAndTarget(target);
+    }
+
+    void setCurrentAndTarget(float value) {
+        current = target = value;
+        countdown = 0;
+    }
+
+    void setTarget(float value) {
+        if (value == target) return;
+        if (stepsToTarget <= 0) {
+            setCurrentAndTarget(value);
+            return;
+        }
+
+        target = value;
+        countdown = stepsToTarget;
+        step = std::exp(
+            (std::log(std::abs(target)) - std::log(std::abs(current)))
+            / (float)countdown
+        );
+    }
+
+    bool isSmoothing() const { return countdown > 0; }
+
+    float skip(int numSamples) {
+        if (numSamples >= countdown) {
+            setCurrentAndTarget(target);
+            return target;
+        }
+
+        current *= std::pow(step, (float)numSamples);
+        countdown -= numSamples;
+        return current;
+    }
+
+private:
+    float current = 1.0f;
+    float target = 1.0f;
+    float step = 1.0f;
+    int countdown = 0;
+    int stepsToTarget = 0;
+};
+
+struct NoiseFilterSettings {
+    float hpFreq = 4.0f;
+    float hpQ = 1.0f;
+    float lpFreq = 22000.0f;
+    float lpQ = 1.0f;
+};
+
+// Lowpass followed by highpass, used to colour the noise. The coefficients
+// are computed from smoothed settings, once every `updateInterval` samples
+// while a setting is moving, and linearly interpolated per sample in between.
+// Changes therefore reach the filters within the same block, including in
+// offline renders.
+class NoiseFilter {
+public:
+    static constexpr size_t updateInterval = 16;
+
+    void prepare(
+        double rate, int numChannels, int maxBlockSize,
+        const NoiseFilterSettings& initial
+    ) {
+        sampleRate = rate;
+
+        for (auto* smoother : getSmoothers()) {
+            smoother->reset(rate, 0.02);
+        }
+        hpFreq.setCurrentAndTarget(initial.hpFreq);
+        hpQ.setCurrentAndTarget(initial.hpQ);
+        lpFreq.setCurrentAndTarget(initial.lpFreq);
+        lpQ.setCurrentAndTarget(initial.lpQ);
+
+        blockStart = computeCoefficients(
+            initial.hpFreq, initial.hpQ, initial.lpFreq, initial.lpQ
+        );
+
+        segmentEnds.resize(
+            ((size_t)maxBlockSize + updateInterval - 1) / updateInterval
+        );
+        numSegments = 0;
+
+        constexpr size_t floatWidth = Vec<float>::size;
+        floatStates.assign(
+            ((size_t)numChannels + floatWidth - 1) / floatWidth, State<float>{}
+        );
+
+        constexpr size_t doubleWidth = Vec<double>::size;
+        doubleStates.assign(
+            ((size_t)numChannels + doubleWidth - 1) / doubleWidth,
+            State<double>{}
+        );
+    }
+
+    // Clears the filter states, keeping the coefficients.
+    void reset() {
+        std::fill(floatStates.begin(), floatStates.end(), State<float>{});
+        std::fill(doubleStates.begin(), doubleStates.end(), State<double>{});
+    }
+
+    // Plans the coefficient trajectory for the next `numSamples` samples.
+    // Must be called once per block, before process().
+    void beginBlock(size_t numSamples, const NoiseFilterSettings& targets) {
+        if (numSegments > 0) blockStart = segmentEnds[numSegments - 1];
+
+        hpFreq.setTarget(targets.hpFreq);
+        hpQ.setTarget(targets.hpQ);
+        lpFreq.setTarget(targets.lpFreq);
+        lpQ.setTarget(targets.lpQ);
+
+        bool isRamping = hpFreq.isSmoothing() || hpQ.isSmoothing()
+            || lpFreq.isSmoothing() || lpQ.isSmoothing();
+
+        if (!isRamping) {
+            numSegments = 0;
+            return;
+        }
+
+        numSegments = (numSamples + updateInterval - 1) / updateInterval;
+        assert(numSegments <= segmentEnds.size());
+
+        for (size_t segment = 0; segment < numSegments; segment++) {
+            auto length = (int)std::min(
+                updateInterval, numSamples - segment * updateInterval
+            );
+
+            segmentEnds[segment] = computeCoefficients(
+                hpFreq.skip(length),
+                hpQ.skip(length),
+                lpFreq.skip(length),
+                lpQ.skip(length)
+            );
+        }
+    }
+
+    // Filters `numChannels` channels in place, a SIMD register's worth at a
+    // time.
+    template <typename T>
+    void process(T* const* channels, size_t numChannels, size_t numSamples) {
+        constexpr size_t width = Vec<T>::size;
+
+        auto& states = getStates<T>();
+        assert((numChannels + width - 1) / width <= states.size());
+
+        // The filters are recursive in time, so channels share a register
+        // instead, one per lane. Coefficients are interpolated once per group.
+        for (size_t first = 0; first < numChannels; first += width) {
+            auto& state = states[first / width];
+            auto numLanes = std::min(width, numChannels - first);
+
+            auto filterFrame = [&](
+                                   size_t i, const Section<T>& lp,
+                                   const Section<T>& hp
+                               ) {
+                std::array<T, width> frame{};
+                for (size_t lane = 0; lane < numLanes; lane++) {
+                    frame[lane] = channels[first + lane][i];
+                }
+
+                Vec<T> band;
+                auto x = Vec<T>::load(frame.data());
+                x = tick(lp, x, state.lp1, state.lp2, band);
+
+                auto low = tick(hp, x, state.hp1, state.hp2, band);
+                x = x - band * hp.k - low;
+                x.store(frame.data());
+
+                for (size_t lane = 0; lane < numLanes; lane++) {
+                    channels[first + lane][i] = frame[lane];
+                }
+            };
+
+            if (numSegments == 0) {
+                Section<T> lp{ blockStart.lp };
+                Section<T> hp{ blockStart.hp };
+
+                for (size_t i = 0; i < numSamples; i++) {
+                    filterFrame(i, lp, hp);
+                }
+                continue;
+            }
+
+            for (size_t segment = 0; segment < numSegments; segment++) {
+                const auto& from =
+                    segment == 0 ? blockStart : segmentEnds[segment - 1];
+                const auto& to = segmentEnds[segment];
+
+                Section<T> lpFrom{ from.lp }, lpTo{ to.lp };
+                Section<T> hpFrom{ from.hp }, hpTo{ to.hp };
+
+                size_t start = segment * updateInterval;
+                size_t length = std::min(updateInterval, numSamples - start);
+
+                for (size_t k = 0; k < length; k++) {
+                    auto t = (T)(k + 1) / (T)length;
+
+                    filterFrame(
+                        start + k,
+                        lpFrom.interpolate(lpTo, t),
+                        hpFrom.interpolate(hpTo, t)
+                    );
+                }
+            }
+        }
+    }
+
+private:
+    struct Coefficients {
+        SvfCoefficients hp;
+        SvfCoefficients lp;
+    };
+
+    template <typename T> struct Section {
+        T k, a1, a2, a3;
+
+        Section() = default;
+        Section(const SvfCoefficients& c)
+            : k((T)c.k), a1((T)c.a1), a2((T)c.a2), a3((T)c.a3) {}
+
+        Section interpolate(const Section& to, T t) const {
+            Section c;
+            c.k = k + (to.k - k) * t;
+            c.a1 = a1 + (to.a1 - a1) * t;
+            c.a2 = a2 + (to.a2 - a2) * t;
+            c.a3 = a3 + (to.a3 - a3) * t;
+            return c;
+        }
+    };
+
+    // Filter state of a group of channels, one per SIMD lane.
+    template <typename T> struct State {
+        Vec<T> lp1 = Vec<T>::broadcast(0);
+        Vec<T> lp2 = Vec<T>::broadcast(0);
+        Vec<T> hp1 = Vec<T>::broadcast(0);
+        Vec<T> hp2 = Vec<T>::broadcast(0);
+    };
+
+    // One step of a TPT state variable filter, returning the lowpass output
+    // and the bandpass output in `band`.
+    template <typename T>
+    static Vec<T> tick(
+        const Section<T>& c, Vec<T> v0, Vec<T>& ic1, Vec<T>& ic2, Vec<T>& band
+    ) {
+        Vec<T> v3 = v0 - ic2;
+        Vec<T> v1 = ic1 * c.a1 + v3 * c.a2;
+        Vec<T> v2 = ic2 + ic1 * c.a2 + v3 * c.a3;
+
+        ic1 = v1 * (T)2 - ic1;
+        ic2 = v2 * (T)2 - ic2;
+
+        band = v1;
+        return v2;
+    }
+
+    Coefficients computeCoefficients(
+        float hpFreqValue, float hpQValue, float lpFreqValue, float lpQValue
+    ) const {
+        Coefficients coefficients;
+        coefficients.hp =
+            SvfCoefficients::make(sampleRate, hpFreqValue, hpQValue);
+        coefficients.lp =
+            SvfCoefficients::make(sampleRate, lpFreqValue, lpQValue);
+        return coefficients;
+    }
+
+    std::array<MultiplicativeSmoother*, 4> getSmoothers() {
+        return { &hpFreq, &hpQ, &lpFreq, &lpQ };
+    }
+
+    template <typename T> std::vector<State<T>>& getStates() {
+        if constexpr (std::is_same_v<T, float>) {
+            return floatStates;
+        } else {
+            return doubleStates;
+        }
+    }
+
+    double sampleRate = 44100.0;
+
+    MultiplicativeSmoother hpFreq;
+    MultiplicativeSmoother hpQ;
+    MultiplicativeSmoother lpFreq;
+    MultiplicativeSmoother lpQ;
+
+    // Coefficients at the start of the current block and at the end of each
+    // of its update intervals. Only the first is used while nothing moves.
+    Coefficients blockStart;
+    std::vector<Coefficients> segmentEnds;
+    size_t numSegments = 0;
+
+    std::vector<State<float>> floatStates;
+    std::vector<State<double>> doubleStates;
+};
+
+} // namespace noisat::core
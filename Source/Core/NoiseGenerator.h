@@ -0,0 +1,127 @@
+#pragma once
+
+#include "Philox.h"
+
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace noisat::core {
+
+// Block-based white noise source with one independent stream per channel,
+// plus a common stream that is blended into every channel to set the
+// inter-channel correlation. The noise is a pure function of the seed, the
+// channel and the sample position: one Philox call on the position and a
+// group of four lanes gives a sample for each of them. The calls for
+// consecutive positions run side by side in SIMD registers, and each word
+// they return holds a run of consecutive samples of one lane. Any stretch of
+// the streams can be rendered without the samples before it, so a render
+// split into pieces comes out the same as one made in a single pass.
+//
+// Output is uniform in (-0.5, 0.5) and symmetric around zero.
+class NoiseGenerator {
+public:
+    void prepare(int channels, int maxBlockSize) {
+        numChannels = channels;
+
+        // One lane per channel plus the common lane, rounded up to whole
+        // groups of the four values each Philox call returns.
+        numLanes = (channels + 1 + laneAlignment - 1) / laneAlignment
+            * laneAlignment;
+
+        // Each lane is rendered in whole registers, so a block may run past
+        // its end by up to one.
+        laneLength = (maxBlockSize + batchSize - 1) / batchSize * batchSize;
+        bits.assign((size_t)(numLanes * laneLength), 0);
+        frames.assign((size_t)((channels + 1) * laneLength), 0.0f);
+    }
+
+    void setSeed(uint64_t newSeed) { seed = newSeed; }
+
+    // 0 gives fully independent channels, 1 the same noise on every channel.
+    void setCorrelation(float correlation) {
+        // Blending with square-root gains keeps the variance of each channel
+        // constant while the covariance between channels equals
+        // `correlation`.
+        commonGain = std::sqrt(correlation);
+        channelGain = std::sqrt(1.0f - correlation);
+    }
+
+    // Renders the samples from `position` on.
+    template <typename T>
+    void generate(T* const* channels, int numSamples, uint64_t position) {
+        assert(numSamples <= laneLength);
+
+        for (int i = 0; i < numSamples; i += batchSize) {
+            std::array<uint32_t, batchSize> low;
+            std::array<uint32_t, batchSize> high;
+            for (int k = 0; k < batchSize; k++) {
+                auto n = position + (uint64_t)(i + k);
+                low[(size_t)k] = (uint32_t)n;
+                high[(size_t)k] = (uint32_t)(n >> 32);
+            }
+            auto lowWords = Words::load(low.data());
+            auto highWords = Words::load(high.data());
+
+            for (int lane = 0; lane < numLanes; lane += laneAlignment) {
+                auto group = (uint32_t)(lane / laneAlignment);
+                auto words = philox(
+                    PhiloxCounters{ lowWords,
+                                    highWords,
+                                    Words::broadcast(group),
+                                    Words::broadcast(0) },
+                    seed
+                );
+
+                for (int k = 0; k < laneAlignment; k++) {
+                    words[(size_t)k].store(
+                        bits.data() + (lane + k) * laneLength + i
+                    );
+                }
+            }
+        }
+
+        // Maps the top 24 bits to odd multiples of 2^-25, which is exactly
+        // symmetric around zero.
+        constexpr float scale = 1.0f / 16777216.0f;
+
+        for (int lane = 0; lane <= numChannels; lane++) {
+            const auto* source = bits.data() + lane * laneLength;
+            auto* frame = frames.data() + lane * laneLength;
+
+            for (int i = 0; i < numSamples; i++) {
+                frame[i] = ((float)((int32_t)source[i] >> 8) + 0.5f) * scale;
+            }
+        }
+
+        const auto* common = frames.data() + numChannels * laneLength;
+        for (int channel = 0; channel < numChannels; channel++) {
+            auto* out = channels[channel];
+            const auto* own = frames.data() + channel * laneLength;
+
+            for (int i = 0; i < numSamples; i++) {
+                out[i] = (T)(own[i] * channelGain + common[i] * commonGain);
+            }
+        }
+    }
+
+private:
+    using Words = Vec<uint32_t>;
+    static constexpr int laneAlignment = 4;
+    static constexpr int batchSize = (int)Words::size;
+
+    int numChannels = 0;
+    int numLanes = 0;
+    int laneLength = 0;
+    uint64_t seed = 0;
+    float commonGain = 0.0f;
+    float channelGain = 1.0f;
+
+    // Lane after lane, the raw bits and then the samples made from them.
+    std::vector<uint32_t> bits;
+    std::vector<float> frames;
+};
+
+} // namespace noisat::core
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Simd.h"
+
+#include <array>
+#include <cstdint>
+
+namespace noisat::core {
+
+// Philox4x32-10 counter-based random number generator, from Salmon et al.,
+// "Parallel Random Numbers: As Easy as 1, 2, 3". Maps a 128-bit counter and
+// a 64-bit key to 128 random bits with no state in between, so any point of a
+// stream can be computed directly instead of by stepping through everything
+// before it.
+using PhiloxCounter = std::array<uint32_t, 4>;
+
+// Several counters at once, one register per word, each lane of which
+// belongs to another counter. Gives the same bits as a philox() call on each.
+using PhiloxCounters = std::array<Vec<uint32_t>, 4>;
+
+constexpr uint32_t philoxMultiplier0 = 0xd2511f53u;
+constexpr uint32_t philoxMultiplier1 = 0xcd9e8d57u;
+constexpr uint32_t philoxWeyl0 = 0x9e3779b9u;
+constexpr uint32_t philoxWeyl1 = 0xbb67ae85u;
+
+inline PhiloxCounter philox(PhiloxCounter counter, uint64_t key) {
+    auto k0 = (uint32_t)key;
+    auto k1 = (uint32_t)(key >> 32);
+
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = (uint64_t)philoxMultiplier0 * counter[0];
+        uint64_t p1 = (uint64_t)philoxMultiplier1 * counter[2];
+
+        counter = { (uint32_t)(p1 >> 32) ^ counter[1] ^ k0,
+                    (uint32_t)p1,
+                    (uint32_t)(p0 >> 32) ^ counter[3] ^ k1,
+                    (uint32_t)p0 };
+
+        k0 += philoxWeyl0;
+        k1 += philoxWeyl1;
+    }
+
+    return counter;
+}
+
+inline PhiloxCounters philox(PhiloxCounters counters, uint64_t key) {
+    using Words = Vec<uint32_t>;
+    auto m0 = Words::broadcast(philoxMultiplier0);
+    auto m1 = Words::broadcast(philoxMultiplier1);
+
+    auto k0 = (uint32_t)key;
+    auto k1 = (uint32_t)(key >> 32);
+
+    for (int round = 0; round < 10; round++) {
+        Words low0, high0, low1, high1;
+        multiplyWide(counters[0], m0, low0, high0);
+        multiplyWide(counters[2], m1, low1, high1);
+
+        counters = { high1 ^ counters[1] ^ Words::broadcast(k0),
+                     low1,
+                     high0 ^ counters[3] ^ Words::broadcast(k1),
+                     low0 };
+
+        k0 += philoxWeyl0;
+        k1 += philoxWeyl1;
+    }
+
+    return counters;
+}
+
+} // namespace noisat::core
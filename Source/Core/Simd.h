@@ -0,0 +1,345 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64)                                      \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NOISAT_CORE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define NOISAT_CORE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace noisat::core {
+
+// Minimal fixed width SIMD register, holding 128 bits of float or double, or
+// of 32-bit words for the random number generator. Backed by SSE2 or NEON
+// where available and by plain arrays otherwise, with just the operations the
+// kernels need. The free functions below are also
+// defined for scalars, so that kernels can be written once and run on
+// vectors for the body of a block and on single samples for its tail.
+template <typename T> struct Vec;
+
+#if NOISAT_CORE_SSE2
+template <> struct Vec<float> {
+    static constexpr size_t size = 4;
+    __m128 value;
+
+    static Vec load(const float* data) { return { _mm_loadu_ps(data) }; }
+    static Vec broadcast(float x) { return { _mm_set1_ps(x) }; }
+    void store(float* data) const { _mm_storeu_ps(data, value); }
+
+    friend Vec operator+(Vec a, Vec b) {
+        return { _mm_add_ps(a.value, b.value) };
+    }
+    friend Vec operator-(Vec a, Vec b) {
+        return { _mm_sub_ps(a.value, b.value) };
+    }
+    friend Vec operator*(Vec a, Vec b) {
+        return { _mm_mul_ps(a.value, b.value) };
+    }
+    friend Vec operator/(Vec a, Vec b) {
+        return { _mm_div_ps(a.value, b.value) };
+    }
+    friend Vec minOf(Vec a, Vec b) { return { _mm_min_ps(a.value, b.value) }; }
+    friend Vec maxOf(Vec a, Vec b) { return { _mm_max_ps(a.value, b.value) }; }
+    friend Vec absOf(Vec a) {
+        return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.value) };
+    }
+    friend Vec withSignOf(Vec magnitude, Vec sign) {
+        auto bit = _mm_and_ps(sign.value, _mm_set1_ps(-0.0f));
+        return { _mm_or_ps(magnitude.value, bit) };
+    }
+};
+
+template <> struct Vec<double> {
+    static constexpr size_t size = 2;
+    __m128d value;
+
+    static Vec load(const double* data) { return { _mm_loadu_pd(data) }; }
+    static Vec broadcast(double x) { return { _mm_set1_pd(x) }; }
+    void store(double* data) const { _mm_storeu_pd(data, value); }
+
+    friend Vec operator+(Vec a, Vec b) {
+        return { _mm_add_pd(a.value, b.value) };
+    }
+    friend Vec operator-(Vec a, Vec b) {
+        return { _mm_sub_pd(a.value, b.value) };
+    }
+    friend Vec operator*(Vec a, Vec b) {
+        return { _mm_mul_pd(a.value, b.value) };
+    }
+    friend Vec operator/(Vec a, Vec b) {
+        return { _mm_div_pd(a.value, b.value) };
+    }
+    friend Vec minOf(Vec a, Vec b) { return { _mm_min_pd(a.value, b.value) }; }
+    friend Vec maxOf(Vec a, Vec b) { return { _mm_max_pd(a.value, b.value) }; }
+    friend Vec absOf(Vec a) {
+        return { _mm_andnot_pd(_mm_set1_pd(-0.0), a.value) };
+    }
+    friend Vec withSignOf(Vec magnitude, Vec sign) {
+        auto bit = _mm_and_pd(sign.value, _mm_set1_pd(-0.0));
+        return { _mm_or_pd(magnitude.value, bit) };
+    }
+};
+
+template <> struct Vec<uint32_t> {
+    static constexpr size_t size = 4;
+    __m128i value;
+
+    static Vec load(const uint32_t* data) {
+        return { _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)) };
+    }
+    static Vec broadcast(uint32_t x) { return { _mm_set1_epi32((int)x) }; }
+    void store(uint32_t* data) const {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data), value);
+    }
+
+    friend Vec operator+(Vec a, Vec b) {
+        return { _mm_add_epi32(a.value, b.value) };
+    }
+    friend Vec operator^(Vec a, Vec b) {
+        return { _mm_xor_si128(a.value, b.value) };
+    }
+
+    // The low and high words of the full 64-bit products. SSE2 only
+    // multiplies the even words, so the odd ones are shifted down first.
+    friend void multiplyWide(Vec a, Vec b, Vec& low, Vec& high) {
+        auto even = _mm_mul_epu32(a.value, b.value);
+        auto odd = _mm_mul_epu32(
+            _mm_srli_epi64(a.value, 32), _mm_srli_epi64(b.value, 32)
+        );
+        auto evenWords = _mm_shuffle_epi32(even, _MM_SHUFFLE(3, 1, 2, 0));
+        auto oddWords = _mm_shuffle_epi32(odd, _MM_SHUFFLE(3, 1, 2, 0));
+        low.value = _mm_unpacklo_epi32(evenWords, oddWords);
+        high.value = _mm_unpackhi_epi32(evenWords, oddWords);
+    }
+};
+#elif NOISAT_CORE_NEON
+template <> struct Vec<float> {
+    static constexpr size_t size = 4;
+    float32x4_t value;
+
+    static Vec load(const float* data) { return { vld1q_f32(data) }; }
+    static Vec broadcast(float x) { return { vdupq_n_f32(x) }; }
+    void store(float* data) const { vst1q_f32(data, value); }
+
+    friend Vec operator+(Vec a, Vec b) {
+        return { vaddq_f32(a.value, b.value) };
+    }
+    friend Vec operator-(Vec a, Vec b) {
+        return { vsubq_f32(a.value, b.value) };
+    }
+    friend Vec operator*(Vec a, Vec b) {
+        return { vmulq_f32(a.value, b.value) };
+    }
+    friend Vec operator/(Vec a, Vec b) {
+        return { vdivq_f32(a.value, b.value) };
+    }
+    friend Vec minOf(Vec a, Vec b) { return { vminq_f32(a.value, b.value) }; }
+    friend Vec maxOf(Vec a, Vec b) { return { vmaxq_f32(a.value, b.value) }; }
+    friend Vec absOf(Vec a) { return { vabsq_f32(a.value) }; }
+    friend Vec withSignOf(Vec magnitude, Vec sign) {
+        return { vbslq_f32(
+            vdupq_n_u32(0x80000000u), sign.value, magnitude.value
+        ) };
+    }
+};
+
+template <> struct Vec<double> {
+    static constexpr size_t size = 2;
+    float64x2_t value;
+
+    static Vec load(const double* data) { return { vld1q_f64(data) }; }
+    static Vec broadcast(double x) { return { vdupq_n_f64(x) }; }
+    void store(double* data) const { vst1q_f64(data, value); }
+
+    friend Vec operator+(Vec a, Vec b) {
+        return { vaddq_f64(a.value, b.value) };
+    }
+    friend Vec operator-(Vec a, Vec b) {
+        return { vsubq_f64(a.value, b.value) };
+    }
+    friend Vec operator*(Vec a, Vec b) {
+        return { vmulq_f64(a.value, b.value) };
+    }
+    friend Vec operator/(Vec a, Vec b) {
+        return { vdivq_f64(a.value, b.value) };
+    }
+    friend Vec minOf(Vec a, Vec b) { return { vminq_f64(a.value, b.value) }; }
+    friend Vec maxOf(Vec a, Vec b) { return { vmaxq_f64(a.value, b.value) }; }
+    friend Vec absOf(Vec a) { return { vabsq_f64(a.value) }; }
+    friend Vec withSignOf(Vec magnitude, Vec sign) {
+        return { vbslq_f64(
+            vdupq_n_u64(0x8000000000000000ull), sign.value, magnitude.value
+        ) };
+    }
+};
+
+template <> struct Vec<uint32_t> {
+    static constexpr size_t size = 4;
+    uint32x4_t value;
+
+    static Vec load(const uint32_t* data) { return { vld1q_u32(data) }; }
+    static Vec broadcast(uint32_t x) { return { vdupq_n_u32(x) }; }
+    void store(uint32_t* data) const { vst1q_u32(data, value); }
+
+    friend Vec operator+(Vec a, Vec b) {
+        return { vaddq_u32(a.value, b.value) };
+    }
+    friend Vec operator^(Vec a, Vec b) {
+        return { veorq_u32(a.value, b.value) };
+    }
+
+    // The low and high words of the full 64-bit products.
+    friend void multiplyWide(Vec a, Vec b, Vec& low, Vec& high) {
+        auto first = vreinterpretq_u32_u64(
+            vmull_u32(vget_low_u32(a.value), vget_low_u32(b.value))
+        );
+        auto second = vreinterpretq_u32_u64(
+            vmull_u32(vget_high_u32(a.value), vget_high_u32(b.value))
+        );
+        low.value = vuzp1q_u32(first, second);
+        high.value = vuzp2q_u32(first, second);
+    }
+};
+#else
+template <typename T> struct Vec {
+    static constexpr size_t size = 16 / sizeof(T);
+    T value[size];
+
+    static Vec load(const T* data) {
+        Vec v;
+        std::memcpy(v.value, data, sizeof(v.value));
+        return v;
+    }
+    static Vec broadcast(T x) {
+        Vec v;
+        std::fill(v.value, v.value + size, x);
+        return v;
+    }
+    void store(T* data) const { std::memcpy(data, value, sizeof(value)); }
+
+    template <typename Op> friend Vec apply(Vec a, Vec b, Op op) {
+        Vec v;
+        for (size_t i = 0; i < size; i++) {
+            v.value[i] = op(a.value[i], b.value[i]);
+        }
+        return v;
+    }
+
+    friend Vec operator+(Vec a, Vec b) {
+        return apply(a, b, [](T x, T y) { return x + y; });
+    }
+    friend Vec operator-(Vec a, Vec b) {
+        return apply(a, b, [](T x, T y) { return x - y; });
+    }
+    friend Vec operator*(Vec a, Vec b) {
+        return apply(a, b, [](T x, T y) { return x * y; });
+    }
+    friend Vec operator/(Vec a, Vec b) {
+        return apply(a, b, [](T x, T y) { return x / y; });
+    }
+    friend Vec minOf(Vec a, Vec b) {
+        return apply(a, b, [](T x, T y) { return std::min(x, y); });
+    }
+    friend Vec maxOf(Vec a, Vec b) {
+        return apply(a, b, [](T x, T y) { return std::max(x, y); });
+    }
+    friend Vec absOf(Vec a) {
+        return apply(a, a, [](T x, T) { return std::abs(x); });
+    }
+    friend Vec withSignOf(Vec magnitude, Vec sign) {
+        return apply(magnitude, sign, [](T x, T y) {
+            return std::copysign(x, y);
+        });
+    }
+
+    // For 32-bit words only.
+    friend Vec operator^(Vec a, Vec b) {
+        return apply(a, b, [](T x, T y) { return x ^ y; });
+    }
+    friend void multiplyWide(Vec a, Vec b, Vec& low, Vec& high) {
+        for (size_t i = 0; i < size; i++) {
+            auto product = (uint64_t)a.value[i] * b.value[i];
+            low.value[i] = (T)product;
+            high.value[i] = (T)(product >> 32);
+        }
+    }
+};
+#endif
+
+// Scalar counterparts of the register operations.
+inline float minOf(float a, float b) { return std::min(a, b); }
+inline double minOf(double a, double b) { return std::min(a, b); }
+inline float maxOf(float a, float b) { return std::max(a, b); }
+inline double maxOf(double a, double b) { return std::max(a, b); }
+inline float absOf(float a) { return std::abs(a); }
+inline double absOf(double a) { return std::abs(a); }
+inline float withSignOf(float magnitude, float sign) {
+    return std::copysign(magnitude, sign);
+}
+inline double withSignOf(double magnitude, double sign) {
+    return std::copysign(magnitude, sign);
+}
+
+// Element type of a scalar or of a register.
+template <typename T> struct ElementOf {
+    using Type = T;
+};
+template <typename T> struct ElementOf<Vec<T>> {
+    using Type = T;
+};
+template <typename T> using Element = typename ElementOf<T>::Type;
+
+template <typename T> T broadcast(Element<T> x) {
+    if constexpr (std::is_floating_point_v<T>) {
+        return x;
+    } else {
+        return T::broadcast(x);
+    }
+}
+
+// Register operations with a scalar operand, which is broadcast first.
+template <typename T> Vec<T> operator+(Vec<T> a, Element<Vec<T>> b) {
+    return a + Vec<T>::broadcast(b);
+}
+template <typename T> Vec<T> operator+(Element<Vec<T>> a, Vec<T> b) {
+    return Vec<T>::broadcast(a) + b;
+}
+template <typename T> Vec<T> operator-(Vec<T> a, Element<Vec<T>> b) {
+    return a - Vec<T>::broadcast(b);
+}
+template <typename T> Vec<T> operator-(Element<Vec<T>> a, Vec<T> b) {
+    return Vec<T>::broadcast(a) - b;
+}
+template <typename T> Vec<T> operator*(Vec<T> a, Element<Vec<T>> b) {
+    return a * Vec<T>::broadcast(b);
+}
+template <typename T> Vec<T> operator*(Element<Vec<T>> a, Vec<T> b) {
+    return Vec<T>::broadcast(a) * b;
+}
+
+template <typename T> T load(const Element<T>* data) {
+    if constexpr (std::is_floating_point_v<T>) {
+        return *data;
+    } else {
+        return T::load(data);
+    }
+}
+
+template <typename T> void store(Element<T>* data, T value) {
+    if constexpr (std::is_floating_point_v<T>) {
+        *data = value;
+    } else {
+        value.store(data);
+    }
+}
+
+} // namespace noisat::core
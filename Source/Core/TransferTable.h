@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace noisat::core {
+
+// Sampled copy of the clipping transfer curve for positive input magnitudes.
+// Magnitudes below `start` pass through unchanged, the rest are looked up at
+// (magnitude - start) * indexScale, scaled by `outScale` and offset by
+// `offset`. Past the last entry the curve continues with `tailSlope`.
+struct TransferTable {
+    static constexpr int size = 8192;
+
+    bool custom = false;
+
+    float start = 0.0f;
+    float indexScale = 0.0f;
+    float outScale = 1.0f;
+    float offset = 0.0f;
+    float tailSlope = 0.0f;
+
+    std::array<float, size + 1> values;
+
+    // Clips both polarities of `numSamples` samples with linear
+    // interpolation between entries. `in` and `out` may alias.
+    template <typename T>
+    void process(const T* in, T* out, size_t numSamples) const {
+        constexpr auto last = (T)size;
+
+        for (size_t i = 0; i < numSamples; i++) {
+            T magnitude = std::abs(in[i]);
+            T position = std::max(magnitude - (T)start, (T)0) * (T)indexScale;
+
+            T clamped = std::min(position, last - 1);
+            auto index = (size_t)clamped;
+            T frac = std::min(position - (T)index, (T)1);
+
+            T value = values[index] + frac * (values[index + 1] - values[index])
+                + std::max(position - last, (T)0) * tailSlope;
+
+            T result =
+                magnitude < start ? magnitude : offset + value * outScale;
+
+            out[i] = std::copysign(result, in[i]);
+        }
+    }
+};
+
+} // namespace noisat::core
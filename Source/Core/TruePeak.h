@@ -0,0 +1,307 @@
+#pragma once
+
+#include "NoiseFilter.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace noisat::core {
+
+// Holds the true peak of the output below a ceiling, as the last stage at the
+// oversampled rate. Clipping the oversampled signal alone is not enough: the
+// decimation filter removes the harmonics the clipping added, and the band
+// limited waveform that is left rings up to about 2 dB past where it was
+// clipped.
+//
+// The oversampled signal already describes the waveform between the output
+// samples, so the true peak after decimation is estimated from it directly
+// rather than by upsampling the output again: an eighth order Butterworth
+// lowpass at the output Nyquist frequency stands in for the decimation
+// filter, and its output tracks the band limited waveform closely enough to
+// read its peaks.
+//
+// The signal is delayed by `lookAhead` host samples and limited in sub-blocks
+// of that length, on a grid counted from the start of the stream, so the
+// output doesn't depend on how the host splits it into blocks. Each sub-block
+// is hard clipped at the ceiling times a compensation gain. If the estimate
+// goes over, within the sub-block or in the ringing that follows it, the
+// sub-block is clipped again at a gain lowered by the overshoot, which
+// usually lands below the ceiling at the second attempt. Should every attempt
+// fail, the sub-block is scaled down just far enough for the estimate to stay
+// below. The gain recovers smoothly once the overs stop. A sub-block with no
+// overs costs two passes of the estimation filter.
+//
+// Without oversampling there is no waveform between the samples to go by,
+// and the ceiling only holds the sample peaks.
+class TruePeakCeiling {
+public:
+    // Delay in host samples, to be reported as latency. The sub-blocks are
+    // this long as well.
+    static constexpr int lookAhead = 32;
+
+    // Time constant of the gain recovering after an over.
+    static constexpr double releaseSeconds = 0.05;
+
+    // `sampleRate` is the oversampled rate. The delay lines are sized for
+    // `maxFactor`, so that preparing for another factor up to that doesn't
+    // allocate.
+    void prepare(
+        double sampleRate, int factor, int maxFactor, int numChannels
+    ) {
+        estimates = factor > 1;
+        for (size_t i = 0; i < numSections; i++) {
+            auto q = 1.0 / (2.0 * std::sin(pi * (double)(2 * i + 1) / 16.0));
+            sections[i] = SvfCoefficients::make(
+                sampleRate, 0.5 * sampleRate / factor, q
+            );
+        }
+
+        blockLength = lookAhead * factor;
+        blockRelease = std::exp(
+            -(double)blockLength / (releaseSeconds * sampleRate)
+        );
+
+        auto capacity = (size_t)(lookAhead * std::max(factor, maxFactor));
+        channels.resize((size_t)numChannels);
+        for (auto& channel : channels) {
+            channel.input.resize(capacity);
+            channel.output.resize(capacity);
+        }
+        reset();
+    }
+
+    // Starts again from silence at the next call to process().
+    void reset() { started = false; }
+
+    // Processes `numSamples` samples of every channel in place, which come
+    // out `lookAhead` host samples later. `position` is that of the first
+    // sample in the stream, at the oversampled rate. When not `enabled`, the
+    // samples are only delayed, at the cost of a copy, and the estimate
+    // catches up on the last sub-block once enabled again. `ceiling` is a
+    // linear gain.
+    template <typename T>
+    void process(
+        T* const* samples, int numSamples, uint64_t position, bool enabled,
+        float ceiling
+    ) {
+        if (!started || position != nextPosition) restart(position);
+        nextPosition = position + (uint64_t)numSamples;
+
+        int done = 0;
+        while (done < numSamples) {
+            auto length = std::min(numSamples - done, blockLength - filled);
+
+            for (size_t channel = 0; channel < channels.size(); channel++) {
+                auto* input = channels[channel].input.data() + filled;
+                auto* output = channels[channel].output.data() + filled;
+                auto* io = samples[channel] + done;
+
+                for (int i = 0; i < length; i++) {
+                    input[i] = (double)io[i];
+                    io[i] = (T)output[i];
+                }
+            }
+
+            filled += length;
+            done += length;
+            if (filled < blockLength) break;
+
+            for (auto& channel : channels) {
+                if (enabled) {
+                    limit(channel, ceiling);
+                } else {
+                    std::copy_n(
+                        channel.input.begin(), blockLength,
+                        channel.output.begin()
+                    );
+                    channel.gain = 1.0;
+                    channel.stale = true;
+                }
+            }
+            filled = 0;
+        }
+    }
+
+private:
+    static constexpr size_t numSections = 4;
+    static constexpr int maxAttempts = 4;
+
+    // The estimate runs up to about 0.4 dB below the decimated waveform at
+    // high factors, so it is held this much lower than the ceiling. Gain
+    // reductions aim a little further down, so that the next attempt does
+    // not stop just short of it.
+    static constexpr double headroom = 0.95;
+    static constexpr double target = 0.94;
+
+    struct Filter {
+        std::array<double, numSections> ic1{};
+        std::array<double, numSections> ic2{};
+    };
+
+    // `input` collects the sub-block being filled, while `output` holds the
+    // last one limited, on its way out. The filter is `stale` after sub-blocks
+    // that were only delayed.
+    struct Channel {
+        Filter filter;
+        bool stale = false;
+        double gain = 1.0;
+        std::vector<double> input;
+        std::vector<double> output;
+    };
+
+    // Clips a sub-block at a ceiling moving linearly from `start` to `end`.
+    struct Ramp {
+        double start;
+        double end;
+
+        double at(int i, int numSamples) const {
+            return start + (end - start) * (double)i / (double)numSamples;
+        }
+    };
+
+    // Sub-blocks stay on the grid the stream started on, with the part
+    // before the first sample silent.
+    void restart(uint64_t position) {
+        for (auto& channel : channels) {
+            channel.filter = {};
+            channel.stale = false;
+            channel.gain = 1.0;
+            std::fill(channel.input.begin(), channel.input.end(), 0.0);
+            std::fill(channel.output.begin(), channel.output.end(), 0.0);
+        }
+        filled = (int)(position % (uint64_t)blockLength);
+        started = true;
+    }
+
+    double estimate(Filter& filter, double x) const {
+        for (size_t s = 0; s < numSections; s++) {
+            const auto& c = sections[s];
+            auto& ic1 = filter.ic1[s];
+            auto& ic2 = filter.ic2[s];
+
+            auto v3 = x - ic2;
+            auto v1 = c.a1 * ic1 + c.a2 * v3;
+            auto v2 = ic2 + c.a2 * ic1 + c.a3 * v3;
+            ic1 = 2.0 * v1 - ic1;
+            ic2 = 2.0 * v2 - ic2;
+            x = v2;
+        }
+        return x;
+    }
+
+    void limit(Channel& channel, double ceiling) const {
+        const auto* input = channel.input.data();
+        auto* output = channel.output.data();
+
+        if (!estimates) {
+            for (int i = 0; i < blockLength; i++) {
+                output[i] = std::clamp(input[i], -ceiling, ceiling);
+            }
+            return;
+        }
+
+        // Only the last sub-block is still in `output`. The estimation filter
+        // forgets quickly enough for that to be close, and the headroom
+        // covers the rest.
+        if (channel.stale) {
+            channel.filter = {};
+            for (int i = 0; i < blockLength; i++) {
+                estimate(channel.filter, output[i]);
+            }
+            channel.stale = false;
+        }
+
+        auto bound = ceiling * headroom;
+        auto recovered = 1.0 - (1.0 - channel.gain) * blockRelease;
+        Ramp ramp{ channel.gain * ceiling, recovered * ceiling };
+
+        // Every attempt runs the estimate from the same starting state, and
+        // only the accepted one is kept. The ringing after the sub-block is
+        // checked as well, against the level it ends at: the next one can
+        // only add to it.
+        Filter filter;
+        double peak = 0.0;
+        for (int attempt = 0; attempt < maxAttempts; attempt++) {
+            filter = channel.filter;
+            peak = 0.0;
+
+            double overshoot = 0.0;
+            for (int i = 0; i < blockLength; i++) {
+                auto level = ramp.at(i, blockLength);
+                output[i] = std::clamp(input[i], -level, level);
+
+                auto y = std::abs(estimate(filter, output[i]));
+                peak = std::max(peak, y);
+                overshoot = std::max(overshoot, y / level);
+            }
+
+            auto ringing = filter;
+            for (int i = 0; i < blockLength; i++) {
+                auto y = std::abs(estimate(ringing, 0.0));
+                peak = std::max(peak, y);
+                overshoot = std::max(overshoot, y / ramp.end);
+            }
+
+            if (peak <= bound) break;
+
+            // Lower the whole sub-block, so that a later over cannot be
+            // reached while the clip level is still ramping up. The
+            // overshoot is taken against the clip level where it happened,
+            // which keeps the new gain from depending on the gain before.
+            auto lowered = target / overshoot * ceiling;
+            ramp = { lowered, lowered };
+        }
+        channel.gain = ramp.end / ceiling;
+
+        if (peak > bound) {
+            auto scale = scaleToFit(channel.filter, output, bound);
+            filter = channel.filter;
+            for (int i = 0; i < blockLength; i++) {
+                output[i] *= scale;
+                estimate(filter, output[i]);
+            }
+            channel.gain *= scale;
+        }
+        channel.filter = filter;
+    }
+
+    // The largest gain for `block` that keeps the estimate within `bound`
+    // over the sub-block and the ringing after it. The estimate is the
+    // response to the state left by the sub-blocks before, which has already
+    // been checked, plus the response to this one from rest, which scales
+    // with the gain.
+    double scaleToFit(
+        const Filter& state, const double* block, double bound
+    ) const {
+        auto left = state;
+        Filter own;
+        double scale = 1.0;
+
+        for (int i = 0; i < 2 * blockLength; i++) {
+            auto before = estimate(left, 0.0);
+            auto added = estimate(own, i < blockLength ? block[i] : 0.0);
+
+            if (added > 0.0) {
+                scale = std::min(scale, (bound - before) / added);
+            } else if (added < 0.0) {
+                scale = std::min(scale, (-bound - before) / added);
+            }
+        }
+        return std::max(scale, 0.0);
+    }
+
+    bool estimates = false;
+    std::array<SvfCoefficients, numSections> sections;
+    int blockLength = lookAhead;
+    double blockRelease = 0.0;
+
+    bool started = false;
+    uint64_t nextPosition = 0;
+    int filled = 0;
+    std::vector<Channel> channels;
+};
+
+} // namespace noisat::core
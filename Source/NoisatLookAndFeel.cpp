@@ -3,7 +3,8 @@
 #include "FontManager.h"
 
 NoisatLookAndFeel::NoisatLookAndFeel() {
-    knob = juce::PNGImageFormat::loadFrom(
+    // Decoded once for every editor in the process.
+    knob = juce::ImageCache::getFromMemory(
         BinaryData::Knob_png, BinaryData::Knob_pngSize
     );
 }
@@ -17,15 +18,20 @@ void NoisatLookAndFeel::drawRotarySlider(
     float titleHeight = 12.0f;
 
     {
-        float totalRotation = rotaryEndAngle - rotaryStartAngle;
         float size = (float)std::min(width, height) - titleHeight;
-        g.drawImageTransformed(
-            knob,
-            juce::AffineTransform::scale(size / 110.0f)
-                .translated(-size * 0.5f, -size * 0.5f)
-                .rotated(rotaryStartAngle + totalRotation * sliderPos)
-                .translated(size * 0.5f + titleHeight * 0.5f, size * 0.5f)
-        );
+        auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+        auto pixelSize = juce::roundToInt(size * scale);
+
+        if (pixelSize > 0) {
+            const auto& filmstrip = getFilmstrip(
+                { pixelSize, rotaryStartAngle, rotaryEndAngle }
+            );
+            auto frame = juce::roundToInt(sliderPos * (numFrames - 1));
+            g.drawImage(
+                filmstrip.frames[(size_t)juce::jlimit(0, numFrames - 1, frame)],
+                juce::Rectangle<float>(titleHeight * 0.5f, 0.0f, size, size)
+            );
+        }
     }
 
     {
@@ -44,4 +50,51 @@ void NoisatLookAndFeel::drawRotarySlider(
             juce::Justification::centred
         );
     }
-}
\ No newline at end of file
+}
+
+const NoisatLookAndFeel::Filmstrip&
+NoisatLookAndFeel::getFilmstrip(const FilmstripKey& key) {
+    auto it = filmstrips.find(key);
+    if (it == filmstrips.end()) {
+        for (auto i = filmstrips.begin(); i != filmstrips.end();) {
+            i = i->second.drawn ? std::next(i) : filmstrips.erase(i);
+        }
+        for (auto& [heldKey, held] : filmstrips) {
+            held.drawn = false;
+        }
+
+        auto filmstrip = filmstripCache->get(key, [this, &key](Filmstrip& f) {
+            renderFilmstrip(f, key);
+        });
+        it = filmstrips.emplace(key, HeldFilmstrip{ filmstrip }).first;
+    }
+
+    it->second.drawn = true;
+    return *it->second.filmstrip;
+}
+
+void NoisatLookAndFeel::renderFilmstrip(
+    Filmstrip& filmstrip, const FilmstripKey& key
+) const {
+    auto [pixelSize, startAngle, endAngle] = key;
+    auto size = (float)pixelSize;
+
+    filmstrip.frames.resize((size_t)numFrames);
+    for (int i = 0; i < numFrames; i++) {
+        float angle = startAngle
+            + (endAngle - startAngle) * (float)i / (float)(numFrames - 1);
+
+        juce::Image frame(juce::Image::ARGB, pixelSize, pixelSize, true);
+        juce::Graphics g(frame);
+        g.setImageResamplingQuality(juce::Graphics::highResamplingQuality);
+        g.drawImageTransformed(
+            knob,
+            juce::AffineTransform::scale(size / (float)knob.getWidth())
+                .translated(-size * 0.5f, -size * 0.5f)
+                .rotated(angle)
+                .translated(size * 0.5f, size * 0.5f)
+        );
+
+        filmstrip.frames[(size_t)i] = frame;
+    }
+}
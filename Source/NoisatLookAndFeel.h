@@ -1,7 +1,12 @@
 #pragma once
 
+#include "SharedCache.h"
 #include <JuceHeader.h>
 
+// Knobs are drawn from filmstrips: the knob image pre-rendered at a number of
+// rotations, at the physical pixel size it is shown at. Drawing a knob then
+// only copies one frame instead of resampling the rotated image. Filmstrips
+// are shared by every editor in the process.
 class NoisatLookAndFeel : public juce::LookAndFeel_V4 {
 public:
     NoisatLookAndFeel();
@@ -11,5 +16,29 @@ public:
     ) override;
 
 private:
+    static constexpr int numFrames = 128;
+
+    struct Filmstrip {
+        std::vector<juce::Image> frames;
+    };
+
+    // Pixel size, first and last angle.
+    using FilmstripKey = std::tuple<int, float, float>;
+    using FilmstripCache = SharedCache<FilmstripKey, Filmstrip>;
+
+    const Filmstrip& getFilmstrip(const FilmstripKey& key);
+    void renderFilmstrip(Filmstrip& filmstrip, const FilmstripKey& key) const;
+
     juce::Image knob;
+
+    struct HeldFilmstrip {
+        FilmstripCache::Pointer filmstrip;
+        bool drawn = false;
+    };
+
+    // The cache only keeps filmstrips alive while somebody uses them. Each
+    // look and feel holds the ones it drew from since it last needed a new
+    // one, so sizes left behind by resizing the editor are let go of.
+    juce::SharedResourcePointer<FilmstripCache> filmstripCache;
+    std::map<FilmstripKey, HeldFilmstrip> filmstrips;
 };
@@ -16,14 +16,14 @@ void ControlPoint::setXValue(float value) {
     jassert(value >= 0.0f);
     jassert(value <= 1.0f);
     position.x = value;
-    repaint();
+    positionUpdate.trigger();
 }
 
 void ControlPoint::setYValue(float value) {
     jassert(value >= 0.0f);
     jassert(value <= 1.0f);
     position.y = value;
-    repaint();
+    positionUpdate.trigger();
 }
 
 bool ControlPoint::hitTest(int x, int y) {
@@ -137,16 +137,47 @@ void ControlPointAttachment::controlPointValueChanged(ControlPoint* cp) {
 NoiseColorEditor::NoiseColorEditor(NoisatAudioProcessor& p)
     : audioProcessor(p), currentControlPoint(nullptr),
       hpControlAttch(hpControl, *p.noiseEq.hpFreq, *p.noiseEq.hpQ),
-      lpControlAttch(lpControl, *p.noiseEq.lpFreq, *p.noiseEq.lpQ) {
+      lpControlAttch(lpControl, *p.noiseEq.lpFreq, *p.noiseEq.lpQ),
+      vBlank(this, [this] {
+          if (audioProcessor.analyzer.update()) repaint();
+      }) {
     addAndMakeVisible(hpControl);
     addAndMakeVisible(lpControl);
+
+    for (auto* param : { p.noiseEq.hpFreq, p.noiseEq.hpQ, p.noiseEq.lpFreq,
+                         p.noiseEq.lpQ }) {
+        param->addListener(this);
+    }
+
+    spectrumButton.setButtonText("Spectrum");
+    spectrumButton.setClickingTogglesState(true);
+    spectrumButton.onClick = [this] {
+        audioProcessor.analyzer.setEnabled(spectrumButton.getToggleState());
+        repaint();
+    };
+    addAndMakeVisible(spectrumButton);
 }
 
-NoiseColorEditor::~NoiseColorEditor() {}
+NoiseColorEditor::~NoiseColorEditor() {
+    auto& noiseEq = audioProcessor.noiseEq;
+    for (auto* param :
+         { noiseEq.hpFreq, noiseEq.hpQ, noiseEq.lpFreq, noiseEq.lpQ }) {
+        param->removeListener(this);
+    }
+
+    // Nobody looks at the spectrum once the editor is closed.
+    audioProcessor.analyzer.setEnabled(false);
+}
 
 void NoiseColorEditor::resized() {
     hpControl.setBounds(getLocalBounds().withTrimmedBottom(2));
     lpControl.setBounds(getLocalBounds().withTrimmedBottom(2));
+
+    spectrumButton.setBounds(
+        getLocalBounds().removeFromTop(20).removeFromRight(60).reduced(2)
+    );
+
+    curveDirty = true;
 }
 
 void NoiseColorEditor::paint(juce::Graphics& g) {
@@ -161,44 +192,110 @@ void NoiseColorEditor::paint(juce::Graphics& g) {
 
     g.fillAll(juce::Colour::fromRGB(0x11, 0x11, 0x11));
 
-    {
-        int eqWidth = bounds.getWidth();
+    auto sampleRate = audioProcessor.noiseEq.getSampleRate();
+    if (curveDirty || grid.sampleRate != sampleRate) updateCurve(bounds);
+
+    g.setColour(juce::Colour::fromRGB(0x46, 0x1c, 0x00));
+    g.fillPath(eqCurveBackground);
+
+    g.setColour(juce::Colour::fromRGB(0xe8, 0x5d, 0x00));
+    g.strokePath(eqCurve, juce::PathStrokeType(2.0f));
 
-        std::vector<double> freqs(eqWidth);
-        std::vector<double> magnitudes(eqWidth);
+    if (spectrumButton.getToggleState()) paintSpectrum(g, bounds);
+}
+
+void NoiseColorEditor::parameterValueChanged(int, float) {
+    curveUpdate.trigger();
+}
 
-        for (int i = 0; i < eqWidth; i++) {
-            freqs[i] = audioProcessor.noiseEq.hpFreq->convertFrom0to1(
-                (float)i / (float)eqWidth
+void NoiseColorEditor::updateCurve(juce::Rectangle<int> bounds) {
+    auto& noiseEq = audioProcessor.noiseEq;
+    auto width = (size_t)bounds.getWidth();
+    auto height = (float)bounds.getHeight();
+
+    // The frequency of each pixel column only changes with the width, and
+    // its point on the unit circle with the sample rate.
+    if (grid.size() != width || grid.sampleRate != noiseEq.getSampleRate()) {
+        frequencies.resize(width);
+        for (size_t i = 0; i < width; i++) {
+            frequencies[i] = noiseEq.hpFreq->convertFrom0to1(
+                (float)i / (float)width
             );
         }
-        audioProcessor.noiseEq.getMagnitude(
-            freqs.data(), magnitudes.data(), eqWidth
-        );
-        // TODO: Draw freqency gridlines
+        grid.set(frequencies.data(), width, noiseEq.getSampleRate());
+        power.resize(width);
+    }
+
+    noiseEq.getPowerResponse(grid, power.data());
+    // TODO: Draw freqency gridlines
+
+    eqCurve.clear();
+    for (size_t i = 0; i < width; i++) {
+        float x = (float)i;
+        float db = (float)std::log10(power[i]) * 0.25f;
+        float y = height - (db + 1.0f) * 0.5f * height;
+
+        if (i == 0) {
+            eqCurve.startNewSubPath(x, y);
+        } else {
+            eqCurve.lineTo(x, y);
+        }
+    }
 
-        juce::Path eqCurve;
-        for (int i = 0; i < eqWidth; i++) {
-            float x = (float)i;
-            float db = std::log((float)magnitudes[i]) / std::log(10.0f) * 0.5f;
-            float y = (float)bounds.getHeight()
-                - (db + 1.0f) * 0.5f * (float)bounds.getHeight();
+    eqCurveBackground = eqCurve;
+    eqCurveBackground.lineTo((float)width, height);
+    eqCurveBackground.lineTo(0.0f, height);
+    eqCurveBackground.closeSubPath();
 
-            if (i == 0) {
-                eqCurve.startNewSubPath(x, y);
+    curveDirty = false;
+}
+
+void NoiseColorEditor::paintSpectrum(
+    juce::Graphics& g, juce::Rectangle<int> bounds
+) {
+    using Analyzer = SpectrumAnalyzer;
+
+    // Spans the same frequencies as the filter curve. Levels from -96 dB to
+    // 0 dB fill the height.
+    constexpr float minDecibels = -96.0f;
+
+    const auto& spectrum = audioProcessor.analyzer.getSpectrum();
+    if (spectrum.frame == 0) return;
+
+    auto width = (float)bounds.getWidth();
+    auto height = (float)bounds.getHeight();
+    auto* freqParam = audioProcessor.noiseEq.hpFreq;
+
+    const std::array<juce::Colour, Analyzer::numTaps> colours = {
+        juce::Colour::fromRGB(0x88, 0x88, 0x88),
+        juce::Colour::fromRGB(0xe8, 0x5d, 0x00),
+        juce::Colour::fromRGB(0xff, 0xff, 0xff),
+    };
+
+    for (size_t tap = 0; tap < Analyzer::numTaps; tap++) {
+        const auto& levels = spectrum.levels[tap];
+
+        juce::Path path;
+        for (int point = 0; point < Analyzer::numPoints; point++) {
+            auto frequency = Analyzer::minFrequency
+                * std::pow(
+                      Analyzer::maxFrequency / Analyzer::minFrequency,
+                      (float)point / (float)(Analyzer::numPoints - 1)
+                );
+            float x = freqParam->convertTo0to1(frequency) * width;
+            float level = juce::jlimit(
+                0.0f, 1.0f, 1.0f - levels[(size_t)point] / minDecibels
+            );
+            float y = height - level * height;
+
+            if (point == 0) {
+                path.startNewSubPath(x, y);
             } else {
-                eqCurve.lineTo(x, y);
+                path.lineTo(x, y);
             }
         }
 
-        juce::Path eqCurveBackground(eqCurve);
-        eqCurveBackground.lineTo(bounds.getWidth(), bounds.getHeight());
-        eqCurveBackground.lineTo(0, bounds.getHeight());
-        eqCurveBackground.closeSubPath();
-        g.setColour(juce::Colour::fromRGB(0x46, 0x1c, 0x00));
-        g.fillPath(eqCurveBackground);
-
-        g.setColour(juce::Colour::fromRGB(0xe8, 0x5d, 0x00));
-        g.strokePath(eqCurve, juce::PathStrokeType(2.0f));
+        g.setColour(colours[tap].withAlpha(0.7f));
+        g.strokePath(path, juce::PathStrokeType(1.0f));
     }
 }
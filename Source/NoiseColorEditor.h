@@ -1,6 +1,7 @@
 #pragma once
 
 #include "PluginProcessor.h"
+#include "UpdateScheduler.h"
 #include <JuceHeader.h>
 
 template <typename Emitter> class ControlPointListener {
@@ -34,6 +35,9 @@ private:
     bool isDragged;
     juce::ListenerList<ControlPointListener<ControlPoint>> listeners;
     juce::Point<float> startPosition;
+
+    // Both coordinates usually change together, and get repainted together.
+    ScheduledUpdate positionUpdate{ [this] { repaint(); } };
 };
 
 class ControlPointAttachment : private ControlPointListener<ControlPoint> {
@@ -71,15 +75,27 @@ private:
     bool ignoreCallbacks;
 };
 
-class NoiseColorEditor : public juce::Component {
+// Draws the response of the noise filters. The response and its path are
+// cached and only rebuilt when a filter parameter, the size or the sample rate
+// changes, so repaints triggered by the control points stay cheap.
+class NoiseColorEditor : public juce::Component,
+                         public juce::AudioProcessorParameter::Listener {
 public:
     NoiseColorEditor(NoisatAudioProcessor&);
     ~NoiseColorEditor();
 
+    void parameterValueChanged(int parameterIndex, float newValue) override;
+    void parameterGestureChanged(
+        int parameterIndex, bool gestureIsStarting
+    ) override {};
+
     void paint(juce::Graphics&) override;
     void resized() override;
 
 private:
+    void updateCurve(juce::Rectangle<int> bounds);
+    void paintSpectrum(juce::Graphics& g, juce::Rectangle<int> bounds);
+
     NoisatAudioProcessor& audioProcessor;
     ControlPoint hpControl;
     ControlPointAttachment hpControlAttch;
@@ -87,4 +103,21 @@ private:
     ControlPointAttachment lpControlAttch;
 
     ControlPoint* currentControlPoint;
+
+    std::vector<double> frequencies;
+    noisat::core::FrequencyGrid grid;
+    std::vector<double> power;
+    juce::Path eqCurve;
+    juce::Path eqCurveBackground;
+    bool curveDirty = true;
+
+    // Toggles the analyzer, whose spectra are checked for on every display
+    // refresh while it runs.
+    juce::TextButton spectrumButton;
+    juce::VBlankAttachment vBlank;
+
+    ScheduledUpdate curveUpdate{ [this] {
+        curveDirty = true;
+        repaint();
+    } };
 };
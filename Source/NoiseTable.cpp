@@ -0,0 +1,362 @@
+#include "NoiseTable.h"
+
+#include "Core/Philox.h"
+#include "PluginProcessor.h"
+
+class NoiseTable::RenderJob : public juce::ThreadPoolJob {
+public:
+    RenderJob(NoiseTable& o) : juce::ThreadPoolJob("Noise table"), owner(o) {}
+
+    JobStatus runJob() override {
+        owner.render();
+        return jobHasFinished;
+    }
+
+    NoiseTable& owner;
+};
+
+NoiseTable::NoiseTable(DoubleIIR& eq) : noiseEq(eq) {
+    enabled = new juce::AudioParameterBool(
+        "noiseTable", "Cached Noise Table", false
+    );
+
+    for (auto& rate : slotRates) {
+        rate = 0.0;
+    }
+    for (auto& count : reservedUntil) {
+        count = 0;
+    }
+
+    for (int i = 0; i < fadeLength; i++) {
+        fadeIn[(size_t)i] = std::sin(
+            juce::MathConstants<float>::halfPi * (float)i / (float)fadeLength
+        );
+    }
+
+    noiseEq.hpFreq->addListener(this);
+    noiseEq.hpQ->addListener(this);
+    noiseEq.lpFreq->addListener(this);
+    noiseEq.lpQ->addListener(this);
+    enabled->addListener(this);
+}
+
+NoiseTable::~NoiseTable() {
+    noiseEq.hpFreq->removeListener(this);
+    noiseEq.hpQ->removeListener(this);
+    noiseEq.lpFreq->removeListener(this);
+    noiseEq.lpQ->removeListener(this);
+    enabled->removeListener(this);
+
+    struct OwnJobs : juce::ThreadPool::JobSelector {
+        NoiseTable* owner;
+        bool isJobSuitable(juce::ThreadPoolJob* job) override {
+            auto* renderJob = dynamic_cast<RenderJob*>(job);
+            return renderJob != nullptr && &renderJob->owner == owner;
+        }
+    } ownJobs;
+    ownJobs.owner = this;
+
+    worker->pool.removeAllJobs(true, 10000, &ownJobs);
+}
+
+void NoiseTable::parameterValueChanged(int parameterIndex, float newValue) {
+    renderUpdate.trigger();
+}
+
+void NoiseTable::prepare(double rate, int numChannels, int maxBlockSize) {
+    sampleRate = rate;
+
+    // Tables rendered for another rate are skipped by update() and replaced
+    // by the render requested below.
+    activeSlot = -1;
+    previousSlot = -1;
+
+    numLanes = numChannels + 1;
+    switchRemaining = 0;
+    std::get<std::vector<float>>(commonScratch)
+        .assign((size_t)maxBlockSize, 0.0f);
+    std::get<std::vector<double>>(commonScratch)
+        .assign((size_t)maxBlockSize, 0.0);
+
+    // Also called from the audio thread when the oversampling factor
+    // changes, where the render job can't be queued directly.
+    if (juce::MessageManager::getInstance()->isThisTheMessageThread()) {
+        requestRender();
+    } else {
+        renderUpdate.trigger();
+    }
+}
+
+void NoiseTable::requestRender() {
+    if (!enabled->get() || sampleRate.load() <= 0.0) return;
+
+    {
+        const juce::SpinLock::ScopedLockType lock(settingsLock);
+        requestedSettings.sampleRate = sampleRate.load();
+        requestedSettings.hpFreq = noiseEq.hpFreq->get();
+        requestedSettings.hpQ = noiseEq.hpQ->get();
+        requestedSettings.lpFreq = noiseEq.lpFreq->get();
+        requestedSettings.lpQ = noiseEq.lpQ->get();
+    }
+
+    // A job that has not started yet will pick up the new settings.
+    if (!renderQueued.exchange(true)) {
+        worker->pool.addJob(new RenderJob(*this), true);
+    }
+}
+
+void NoiseTable::renderNowIfNeeded() {
+    requestRenderNowIfNeeded();
+
+    // A job that has started holds the render lock until it is done.
+    while (renderQueued.load()) {
+        juce::Thread::sleep(1);
+    }
+    const juce::ScopedLock wait(renderLock);
+}
+
+int NoiseTable::findFreeSlot() const {
+    // Read the pending slot before the active one: the audio thread makes a
+    // pending slot active before clearing it, so a slot can't slip through.
+    int pending = pendingSlot.load();
+    int active = activeSlot.load();
+    int previous = previousSlot.load();
+    auto updates = updateCount.load();
+
+    for (int slot = 0; slot < numSlots; slot++) {
+        if (slot == pending || slot == active || slot == previous) continue;
+        if ((juce::int32)(reservedUntil[(size_t)slot].load() - updates) > 0) {
+            continue;
+        }
+        return slot;
+    }
+
+    return -1;
+}
+
+void NoiseTable::render() {
+    const juce::ScopedLock renderScope(renderLock);
+    renderQueued = false;
+
+    Settings settings;
+    {
+        const juce::SpinLock::ScopedLockType lock(settingsLock);
+        settings = requestedSettings;
+    }
+
+    // Every slot is taken when tables were replaced several times before
+    // the audio thread picked one up. Try again on the next frame, once
+    // update() has released the ones it no longer needs.
+    int slot = findFreeSlot();
+    if (slot < 0) {
+        renderUpdate.trigger();
+        return;
+    }
+
+    auto key = std::make_tuple(
+        settings.sampleRate,
+        settings.hpFreq,
+        settings.hpQ,
+        settings.lpFreq,
+        settings.lpQ
+    );
+    slots[(size_t)slot] = cache->get(key, [&settings](Table& table) {
+        renderTable(settings, table);
+    });
+    slotRates[(size_t)slot] = settings.sampleRate;
+
+    // Only the audio thread clears the pending slot, so if this fails there
+    // is a table it hasn't picked up yet, which the new one replaces.
+    int expected = -1;
+    if (pendingSlot.compare_exchange_strong(expected, slot)) return;
+
+    int superseded = pendingSlot.exchange(slot);
+    if (superseded >= 0) {
+        reservedUntil[(size_t)superseded] = updateCount.load() + 1;
+    }
+}
+
+void NoiseTable::renderTable(const Settings& settings, Table& table) {
+    auto hp = BiquadCoefficients::makeHighPass(
+        settings.sampleRate, settings.hpFreq, settings.hpQ
+    );
+    auto lp = BiquadCoefficients::makeLowPass(
+        settings.sampleRate, settings.lpFreq, settings.lpQ
+    );
+
+    // Random-phase white spectrum shaped by the filter response. Bins are
+    // stored as interleaved real/imaginary pairs for the real-only inverse.
+    juce::dsp::FFT fft(order);
+    std::vector<float> data((size_t)size * 2, 0.0f);
+
+    // A fixed seed gives the same table in every session, so that renders
+    // using it can be reproduced. Instances tell their noise apart by where
+    // they read it.
+    juce::Random random(0x6e6f69736174);
+    double meanPower = 0.0;
+
+    for (int bin = 1; bin < size / 2; bin++) {
+        double freq = settings.sampleRate * bin / size;
+        double magnitude = hp.getMagnitude(freq, settings.sampleRate)
+            * lp.getMagnitude(freq, settings.sampleRate);
+
+        // Box-Muller, giving a complex gaussian with independent parts.
+        double radius = std::sqrt(-2.0 * std::log(1.0 - random.nextDouble()));
+        double angle = juce::MathConstants<double>::twoPi * random.nextDouble();
+
+        data[(size_t)bin * 2] = (float)(magnitude * radius * std::cos(angle));
+        data[(size_t)bin * 2 + 1] =
+            (float)(magnitude * radius * std::sin(angle));
+
+        meanPower += 2.0 * magnitude * magnitude;
+    }
+    meanPower /= size;
+
+    fft.performRealOnlyInverseTransform(data.data());
+
+    // Match the level of the filtered white noise used otherwise, which has
+    // a variance of 1/12 before filtering.
+    double sumOfSquares = 0.0;
+    for (int i = 0; i < size; i++) {
+        sumOfSquares += (double)data[(size_t)i] * data[(size_t)i];
+    }
+
+    double targetRms = std::sqrt(meanPower / 12.0);
+    double actualRms = std::sqrt(sumOfSquares / size);
+    auto gain = (float)(actualRms > 0.0 ? targetRms / actualRms : 0.0);
+
+    table.resize((size_t)size);
+    juce::FloatVectorOperations::multiply(
+        table.data(), data.data(), gain, size
+    );
+}
+
+void NoiseTable::update() {
+    // Counted before the pending slot is read: see reservedUntil.
+    updateCount.fetch_add(1);
+
+    // Only switch tables once the last one has faded in, so that at most two
+    // slots are ever in use here.
+    if (switchRemaining > 0) return;
+
+    previousSlot = -1;
+
+    int pending = pendingSlot.load();
+    if (pending < 0) return;
+
+    if (slotRates[(size_t)pending].load() == sampleRate.load()) {
+        int active = activeSlot.load();
+        previousSlot = active;
+        activeSlot = pending;
+        switchRemaining = active >= 0 ? fadeLength : 0;
+    }
+
+    pendingSlot.compare_exchange_strong(pending, -1);
+}
+
+template <typename SampleType>
+void NoiseTable::read(
+    juce::AudioBuffer<SampleType>& destination, int numSamples,
+    float correlation, juce::uint64 position
+) {
+    jassert(isReady());
+    jassert(destination.getNumChannels() + 1 <= numLanes);
+
+    auto commonGain = (SampleType)std::sqrt(correlation);
+    auto channelGain = (SampleType)std::sqrt(1.0f - correlation);
+
+    const auto& table = *slots[(size_t)activeSlot.load()];
+    int fading = std::min(numSamples, switchRemaining);
+
+    // A new table fades in over the one it replaces, read at the same
+    // positions.
+    auto readLane = [&](int lane, SampleType* out) {
+        readInto(table, lane, out, numSamples, position);
+        if (fading == 0) return;
+
+        std::array<SampleType, fadeLength> previous;
+        const auto& previousTable = *slots[(size_t)previousSlot.load()];
+        readInto(previousTable, lane, previous.data(), fading, position);
+
+        for (int k = 0; k < fading; k++) {
+            int step = fadeLength - switchRemaining + k;
+            out[k] = out[k] * fadeIn[(size_t)step]
+                + previous[(size_t)k]
+                    * fadeIn[(size_t)(fadeLength - 1 - step)];
+        }
+    };
+
+    auto* common = std::get<std::vector<SampleType>>(commonScratch).data();
+    readLane(numLanes - 1, common);
+
+    for (int channel = 0; channel < destination.getNumChannels(); channel++) {
+        auto* out = destination.getWritePointer(channel);
+        readLane(channel, out);
+
+        juce::FloatVectorOperations::multiply(out, channelGain, numSamples);
+        juce::FloatVectorOperations::addWithMultiply(
+            out, common, commonGain, numSamples
+        );
+    }
+
+    switchRemaining -= fading;
+}
+
+template <typename SampleType>
+void NoiseTable::readInto(
+    const Table& table, int lane, SampleType* out, int numSamples,
+    juce::uint64 position
+) const {
+    constexpr int mask = size - 1;
+    const auto* data = table.data();
+
+    // Every lane jumps at its own offset, so that the channels don't all
+    // fade at once.
+    auto n = position + randomFor(lane, 0, 1) % (uint32_t)jumpInterval;
+
+    int i = 0;
+    while (i < numSamples) {
+        auto segment = n / (juce::uint64)jumpInterval;
+        auto step = (int)(n % (juce::uint64)jumpInterval);
+        int chunk = std::min(numSamples - i, jumpInterval - step);
+        int start = (int)(randomFor(lane, segment, 0) & (uint32_t)mask) + step;
+
+        int k = 0;
+        if (step < fadeLength) {
+            // The stretch before the jump carries on under the fade.
+            int end = (int)(randomFor(lane, segment - 1, 0) & (uint32_t)mask)
+                + jumpInterval + step;
+            int fade = std::min(chunk, fadeLength - step);
+
+            for (; k < fade; k++) {
+                out[i + k] = (SampleType)(
+                    data[(start + k) & mask] * fadeIn[(size_t)(step + k)]
+                    + data[(end + k) & mask]
+                        * fadeIn[(size_t)(fadeLength - 1 - step - k)]
+                );
+            }
+        }
+        for (; k < chunk; k++) {
+            out[i + k] = data[(start + k) & mask];
+        }
+
+        n += (juce::uint64)chunk;
+        i += chunk;
+    }
+}
+
+uint32_t
+NoiseTable::randomFor(int lane, juce::uint64 index, uint32_t stream) const {
+    // The last counter word keeps these apart from the generated noise.
+    noisat::core::PhiloxCounter counter{
+        (uint32_t)index, (uint32_t)(index >> 32), (uint32_t)lane, stream + 1
+    };
+    return noisat::core::philox(counter, seed)[0];
+}
+
+template void NoiseTable::read<float>(
+    juce::AudioBuffer<float>&, int, float, juce::uint64
+);
+template void NoiseTable::read<double>(
+    juce::AudioBuffer<double>&, int, float, juce::uint64
+);
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "SharedCache.h"
+#include "UpdateScheduler.h"
+#include <JuceHeader.h>
+
+class DoubleIIR;
+
+// Long, seamlessly looping table of already coloured noise, used instead of
+// generating and filtering white noise on every callback. Tables are rendered
+// in the frequency domain on a shared background thread whenever the noise
+// filter settings change: a random-phase spectrum shaped by the DoubleIIR
+// magnitude response is inverse transformed, which makes the table periodic
+// by construction.
+//
+// Each channel reads the table from its own position and jumps to a new
+// random one at regular intervals, with an equal-power crossfade. A newly
+// rendered table is faded in the same way. The jump positions are drawn from
+// the seed and the sample position, like the generated noise, so reading
+// never depends on what was read before.
+//
+// Tables are immutable once rendered and shared through a SharedCache by all
+// instances using the same filter settings and sample rate. Instances with
+// different seeds still read them from their own random positions.
+class NoiseTable : public juce::AudioProcessorParameter::Listener {
+public:
+    static constexpr int order = 16;
+    static constexpr int size = 1 << order;
+
+    NoiseTable(DoubleIIR& noiseEq);
+    ~NoiseTable();
+
+    void parameterValueChanged(int parameterIndex, float newValue) override;
+    void parameterGestureChanged(
+        int parameterIndex, bool gestureIsStarting
+    ) override {};
+
+    void prepare(double sampleRate, int numChannels, int maxBlockSize);
+
+    // For the audio thread while rendering offline, where the host may be
+    // blocking the message thread. Requests a table for changed settings
+    // right away and waits for it, so that the output doesn't depend on how
+    // long rendering took.
+    void renderNowIfNeeded();
+
+    // Any thread. Requests a table for changed settings right away, without
+    // waiting for the next frame or for the table.
+    void requestRenderNowIfNeeded() { renderUpdate.updateNowIfNeeded(); }
+
+    // Audio thread only. update() picks up newly rendered tables and must be
+    // called once per block before read(), which reads from sample
+    // `position` of the noise streams on.
+    void setSeed(juce::uint64 newSeed) { seed = newSeed; }
+    void update();
+    bool isReady() const { return activeSlot.load() >= 0; }
+    template <typename SampleType>
+    void read(
+        juce::AudioBuffer<SampleType>& destination, int numSamples,
+        float correlation, juce::uint64 position
+    );
+
+    juce::AudioParameterBool* enabled;
+
+private:
+    static constexpr int numSlots = 4;
+    static constexpr int fadeLength = 256;
+    static constexpr int jumpInterval = size / 4;
+
+    struct Settings {
+        double sampleRate = 0.0;
+        float hpFreq = 0.0f;
+        float hpQ = 0.0f;
+        float lpFreq = 0.0f;
+        float lpQ = 0.0f;
+    };
+
+    class RenderJob;
+
+    using Table = std::vector<float>;
+    using TableCache = SharedCache<
+        std::tuple<double, float, float, float, float>, Table>;
+
+    void requestRender();
+    void render();
+    static void renderTable(const Settings& settings, Table& table);
+    int findFreeSlot() const;
+
+    template <typename SampleType>
+    void readInto(
+        const Table& table, int lane, SampleType* out, int numSamples,
+        juce::uint64 position
+    ) const;
+    uint32_t randomFor(int lane, juce::uint64 index, uint32_t stream) const;
+
+    DoubleIIR& noiseEq;
+
+    // Slot bookkeeping shared between the render thread (writer) and the
+    // audio thread (reader). The writer only fills slots that are neither
+    // active, still fading out, waiting to be picked up nor reserved, so the
+    // audio thread never holds the last reference to a table.
+    //
+    // A pending slot replaced before the audio thread got to it may still
+    // have been loaded by an update() running at that moment. It stays
+    // reserved until `updateCount` shows that the next update() has started,
+    // by which time the one that might have loaded it has finished.
+    std::array<std::shared_ptr<const Table>, numSlots> slots;
+    std::array<std::atomic<double>, numSlots> slotRates;
+    std::array<std::atomic<juce::uint32>, numSlots> reservedUntil;
+    std::atomic<int> activeSlot{ -1 };
+    std::atomic<int> previousSlot{ -1 };
+    std::atomic<int> pendingSlot{ -1 };
+    std::atomic<juce::uint32> updateCount{ 0 };
+
+    juce::SpinLock settingsLock;
+    Settings requestedSettings;
+    std::atomic<bool> renderQueued{ false };
+    juce::CriticalSection renderLock;
+
+    std::atomic<double> sampleRate{ 0.0 };
+
+    // Audio thread state.
+    int numLanes = 0;
+    int switchRemaining = 0;
+    juce::uint64 seed = 0;
+    std::tuple<std::vector<float>, std::vector<double>> commonScratch;
+    std::array<float, fadeLength> fadeIn;
+
+    struct Worker {
+        juce::ThreadPool pool{ 1 };
+    };
+    juce::SharedResourcePointer<Worker> worker;
+    juce::SharedResourcePointer<TableCache> cache;
+
+    ScheduledUpdate renderUpdate{ [this] { requestRender(); } };
+};
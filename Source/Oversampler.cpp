@@ -0,0 +1,188 @@
+#include "Oversampler.h"
+
+Oversampler::Oversampler(juce::AudioProcessor& p, int lookAhead)
+    : processor(p), lookAheadLatency(lookAhead) {
+    factor = new juce::AudioParameterChoice(
+        "oversampling",
+        "Oversampling",
+        juce::StringArray{ "1x", "2x", "4x", "8x", "16x" },
+        1
+    );
+    filter = new juce::AudioParameterChoice(
+        "oversamplingFilter",
+        "Oversampling Filter",
+        juce::StringArray{ "IIR", "Linear Phase" },
+        0
+    );
+
+    factor->addListener(this);
+    filter->addListener(this);
+}
+
+Oversampler::~Oversampler() {
+    factor->removeListener(this);
+    filter->removeListener(this);
+    if (lookAheadSwitch != nullptr) lookAheadSwitch->removeListener(this);
+    stopTimer();
+
+    delete pending.exchange(nullptr);
+    delete retired.exchange(nullptr);
+}
+
+void Oversampler::setLookAheadSwitch(juce::AudioParameterBool* parameter) {
+    jassert(lookAheadSwitch == nullptr);
+    lookAheadSwitch = parameter;
+    lookAheadSwitch->addListener(this);
+}
+
+void Oversampler::parameterValueChanged(int parameterIndex, float newValue) {
+    stageUpdate.trigger();
+}
+
+void Oversampler::rebuild() {
+    Settings current;
+    {
+        const juce::SpinLock::ScopedLockType lock(settingsLock);
+        current = settings;
+    }
+    if (current.sampleRate <= 0.0) return;
+
+    auto stage = build(current);
+    stage->generation = ++builtGeneration;
+
+    // A stage the audio thread never picked up can be dropped right away.
+    delete pending.exchange(stage.release());
+    startTimer(50);
+}
+
+void Oversampler::prepare(int numChannels, int maxBlockSize, double rate) {
+    Settings current;
+    current.numChannels = numChannels;
+    current.maxBlockSize = maxBlockSize;
+    current.sampleRate = rate;
+    current.doublePrecision = processor.isUsingDoublePrecision();
+    {
+        const juce::SpinLock::ScopedLockType lock(settingsLock);
+        settings = current;
+    }
+
+    delete pending.exchange(nullptr);
+    delete retired.exchange(nullptr);
+    installedLatency = -1;
+    handledGeneration = builtGeneration.load();
+
+    active = build(current);
+    processor.setLatencySamples(active->latency);
+}
+
+void Oversampler::updateNowIfNeeded() {
+    delete retired.exchange(nullptr);
+    stageUpdate.updateNowIfNeeded();
+}
+
+bool Oversampler::update() {
+    // Wait until the previously replaced stage has been deleted, so that a
+    // single slot is enough to hand stages back.
+    if (retired.load() != nullptr) return false;
+
+    auto* stage = pending.exchange(nullptr);
+    if (stage == nullptr) return false;
+
+    // Read up front, since the message thread may delete the stage as soon
+    // as it is retired, and stored last, once the stage has been dealt with.
+    int generation = stage->generation;
+
+    // Built from settings that a later prepare() has since replaced.
+    if (stage->numChannels != active->numChannels
+        || stage->maxBlockSize != active->maxBlockSize
+        || stage->sampleRate != active->sampleRate
+        || stage->doublePrecision != active->doublePrecision) {
+        retired = stage;
+        handledGeneration = generation;
+        return false;
+    }
+
+    bool rateChanged = stage->factorIndex != active->factorIndex;
+    installedLatency = stage->latency;
+    retired = active.release();
+    active.reset(stage);
+    handledGeneration = generation;
+
+    return rateChanged;
+}
+
+namespace {
+template <typename SampleType>
+std::unique_ptr<juce::dsp::Oversampling<SampleType>> makeOversampling(
+    int numChannels, int factorIndex, bool linearPhase, int maxBlockSize
+) {
+    using Oversampling = juce::dsp::Oversampling<SampleType>;
+
+    auto filterType = linearPhase
+        ? Oversampling::FilterType::filterHalfBandFIREquiripple
+        : Oversampling::FilterType::filterHalfBandPolyphaseIIR;
+
+    // Integer latency adds a short fractional delay where needed, so that
+    // the host can compensate for the stage exactly.
+    auto oversampling = std::make_unique<Oversampling>(
+        (size_t)numChannels, (size_t)factorIndex, filterType, true, true
+    );
+    oversampling->initProcessing((size_t)maxBlockSize);
+
+    return oversampling;
+}
+} // namespace
+
+std::unique_ptr<Oversampler::Stage>
+Oversampler::build(const Settings& current) const {
+    auto stage = std::make_unique<Stage>();
+    stage->factorIndex = juce::jlimit(0, maxFactorIndex, factor->getIndex());
+    stage->numChannels = current.numChannels;
+    stage->maxBlockSize = current.maxBlockSize;
+    stage->sampleRate = current.sampleRate;
+    stage->doublePrecision = current.doublePrecision;
+
+    bool linearPhase = filter->getIndex() == 1;
+    stage->linearPhase = linearPhase;
+    double latency = 0.0;
+
+    if (current.doublePrecision) {
+        auto& oversampling = std::get<1>(stage->oversampling);
+        oversampling = makeOversampling<double>(
+            current.numChannels,
+            stage->factorIndex,
+            linearPhase,
+            current.maxBlockSize
+        );
+        latency = (double)oversampling->getLatencyInSamples();
+    } else {
+        auto& oversampling = std::get<0>(stage->oversampling);
+        oversampling = makeOversampling<float>(
+            current.numChannels,
+            stage->factorIndex,
+            linearPhase,
+            current.maxBlockSize
+        );
+        latency = (double)oversampling->getLatencyInSamples();
+    }
+    stage->lookAhead = stage->factorIndex > 0 && lookAheadSwitch != nullptr
+        && lookAheadSwitch->get();
+    stage->latency = juce::roundToInt(latency)
+        + (stage->lookAhead ? lookAheadLatency : 0);
+
+    return stage;
+}
+
+void Oversampler::timerCallback() {
+    // Read first: everything the audio thread did with the latest stage is
+    // visible below once it has been handled.
+    bool handled = handledGeneration.load() == builtGeneration.load();
+
+    // The host only starts compensating once the stage is actually running.
+    int latency = installedLatency.exchange(-1);
+    if (latency >= 0) processor.setLatencySamples(latency);
+
+    delete retired.exchange(nullptr);
+
+    if (handled) stopTimer();
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "UpdateScheduler.h"
+#include <JuceHeader.h>
+
+// Owns the juce::dsp::Oversampling stage selected by the `factor` and
+// `filter` parameters. Stages are built on the message thread, at most once
+// per frame, whenever either parameter changes and handed to the audio thread
+// without locking. Replaced stages are handed back and deleted on the message
+// thread, so the audio thread never allocates or frees one.
+//
+// Every stage uses integer latency, which is reported to the host through
+// AudioProcessor::setLatencySamples() once the audio thread has installed the
+// stage, so the host never compensates for a stage that isn't running yet.
+// The reported latency includes the look-ahead of the processing at the
+// oversampled rate, while a switch parameter turns it on. Switching it builds
+// a new stage like a change of factor does.
+class Oversampler : public juce::AudioProcessorParameter::Listener,
+                    private juce::Timer {
+public:
+    // 1x, 2x, 4x, 8x and 16x.
+    static constexpr int maxFactorIndex = 4;
+    static constexpr int maxFactor = 1 << maxFactorIndex;
+
+    // `lookAhead` is the delay, in host samples, of what runs at the
+    // oversampled rate while it looks ahead.
+    Oversampler(juce::AudioProcessor& processor, int lookAhead);
+    ~Oversampler();
+
+    // Call before prepare(). The look-ahead only runs, and only counts
+    // towards the latency, while `parameter` is on and the signal is
+    // oversampled.
+    void setLookAheadSwitch(juce::AudioParameterBool* parameter);
+
+    void parameterValueChanged(int parameterIndex, float newValue) override;
+    void parameterGestureChanged(
+        int parameterIndex, bool gestureIsStarting
+    ) override {};
+
+    // Builds a stage for the current settings right away. Must not run
+    // concurrently with the audio thread.
+    void prepare(int numChannels, int maxBlockSize, double sampleRate);
+
+    // Builds a stage for changed settings right away, and deletes the one
+    // replaced last, so that the next update() can install it. For the audio
+    // thread while rendering offline, where the host may be blocking the
+    // message thread that would otherwise do both.
+    void updateNowIfNeeded();
+
+    // Audio thread only. Installs a newly built stage, if there is one.
+    // Returns true when the oversampled rate changed, in which case everything
+    // running at that rate has to be prepared again.
+    bool update();
+
+    // Only the stage for the processor's current precision is built.
+    template <typename SampleType>
+    juce::dsp::Oversampling<SampleType>& getStage() {
+        return *std::get<std::unique_ptr<juce::dsp::Oversampling<SampleType>>>(
+            active->oversampling
+        );
+    }
+    int getFactor() const { return 1 << active->factorIndex; }
+    double getOversampledRate() const {
+        return active->sampleRate * getFactor();
+    }
+    int getLatency() const { return active->latency; }
+    bool hasLookAhead() const { return active->lookAhead; }
+
+    // True when the stage only delays the signal below the host's Nyquist,
+    // with the linear phase filters or without oversampling at all.
+    bool hasLinearPhase() const {
+        return active->linearPhase || active->factorIndex == 0;
+    }
+
+    juce::AudioParameterChoice* factor;
+    juce::AudioParameterChoice* filter;
+
+private:
+    struct Stage {
+        std::tuple<
+            std::unique_ptr<juce::dsp::Oversampling<float>>,
+            std::unique_ptr<juce::dsp::Oversampling<double>>>
+            oversampling;
+        int factorIndex = 0;
+        int latency = 0;
+        int generation = 0;
+        bool linearPhase = false;
+        bool lookAhead = false;
+        int numChannels = 0;
+        int maxBlockSize = 0;
+        double sampleRate = 0.0;
+        bool doublePrecision = false;
+    };
+
+    struct Settings {
+        int numChannels = 0;
+        int maxBlockSize = 0;
+        double sampleRate = 0.0;
+        bool doublePrecision = false;
+    };
+
+    void rebuild();
+    std::unique_ptr<Stage> build(const Settings& settings) const;
+    void timerCallback() override;
+
+    juce::AudioProcessor& processor;
+    const int lookAheadLatency;
+    juce::AudioParameterBool* lookAheadSwitch = nullptr;
+
+    juce::SpinLock settingsLock;
+    Settings settings;
+
+    // `active` belongs to the audio thread. A stage waits in `pending` until
+    // the audio thread picks it up and moves the one it replaces to
+    // `retired`, from where the message thread deletes it. The latency of a
+    // newly installed stage is left in `installedLatency` for the message
+    // thread to report, and is -1 otherwise.
+    //
+    // Stages are numbered as they are built, and the audio thread stores the
+    // number of each one it takes out of `pending` once it is done with it.
+    // The timer keeps running until the latest one has been through there.
+    std::unique_ptr<Stage> active;
+    std::atomic<Stage*> pending{ nullptr };
+    std::atomic<Stage*> retired{ nullptr };
+    std::atomic<int> installedLatency{ -1 };
+    std::atomic<int> builtGeneration{ 0 };
+    std::atomic<int> handledGeneration{ 0 };
+
+    ScheduledUpdate stageUpdate{ [this] { rebuild(); } };
+};
@@ -0,0 +1,66 @@
+#include "PerformanceMonitor.h"
+
+void PerformanceMonitor::prepare(double rate) {
+    sampleRate = rate;
+    secondsPerTick =
+        1.0 / (double)juce::Time::getHighResolutionTicksPerSecond();
+
+    histogram.fill(0);
+    loadSum = 0.0;
+    maxLoad = 0.0;
+    numBlocks = 0;
+    overruns = 0;
+    windowSamples = 0;
+    totalOverruns = 0;
+}
+
+void PerformanceMonitor::record(juce::int64 ticks, int numSamples) {
+    if (numSamples <= 0) return;
+
+    auto load = (double)ticks * secondsPerTick * sampleRate / numSamples;
+    auto bin = std::min((int)(load * binsPerLoad), numBins - 1);
+
+    histogram[(size_t)bin]++;
+    loadSum += load;
+    maxLoad = std::max(maxLoad, load);
+    numBlocks++;
+    if (load > 1.0) overruns++;
+
+    windowSamples += numSamples;
+    if (windowSamples >= (juce::int64)(sampleRate * windowSeconds)) publish();
+}
+
+void PerformanceMonitor::publish() {
+    totalOverruns += overruns;
+    window++;
+
+    auto& stats = published.getWriteBuffer();
+    stats.meanLoad = loadSum / numBlocks;
+    stats.maxLoad = maxLoad;
+    stats.numBlocks = numBlocks;
+    stats.overruns = overruns;
+    stats.totalOverruns = totalOverruns;
+    stats.window = window;
+
+    // Upper edge of the bin holding the 99th percentile, capped by the
+    // maximum so that sparse windows do not overstate it.
+    auto rank = (numBlocks * 99 + 99) / 100;
+    int seen = 0;
+    int bin = 0;
+    for (; bin < numBins - 1; bin++) {
+        seen += histogram[(size_t)bin];
+        if (seen >= rank) break;
+    }
+    stats.p99Load = bin < numBins - 1
+        ? std::min((bin + 1) / binsPerLoad, maxLoad)
+        : maxLoad;
+
+    published.publish();
+
+    histogram.fill(0);
+    loadSum = 0.0;
+    maxLoad = 0.0;
+    numBlocks = 0;
+    overruns = 0;
+    windowSamples = 0;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "TripleBuffer.h"
+#include <JuceHeader.h>
+
+// Callback load over one reporting window. Load is the time spent in
+// processBlock() as a fraction of the block's real-time duration, so 1.0
+// means the callback took as long as the audio it produced.
+struct PerformanceStats {
+    double meanLoad = 0.0;
+    double p99Load = 0.0;
+    double maxLoad = 0.0;
+    int numBlocks = 0;
+
+    // Blocks in this window, and since prepareToPlay(), whose callback took
+    // longer than the block lasts.
+    int overruns = 0;
+    juce::int64 totalOverruns = 0;
+
+    // Counts up with every published window, so that readers can tell a new
+    // window from an unchanged one.
+    juce::int64 window = 0;
+};
+
+// Times every audio callback and publishes PerformanceStats about four times a
+// second. Timing uses the high resolution tick counter and the statistics are
+// collected in a fixed histogram, so the audio thread never locks or
+// allocates. The histogram bins are 0.5% wide, which bounds the error of the
+// p99. Past 200% load the p99 falls back to the maximum.
+class PerformanceMonitor {
+public:
+    // Must not run concurrently with the audio thread.
+    void prepare(double sampleRate);
+
+    // Audio thread only. Measures the lifetime of the object as one callback
+    // producing `numSamples` samples.
+    class ScopedMeasurement {
+    public:
+        ScopedMeasurement(PerformanceMonitor& m, int samples)
+            : monitor(m), numSamples(samples),
+              start(juce::Time::getHighResolutionTicks()) {}
+        ~ScopedMeasurement() {
+            monitor.record(
+                juce::Time::getHighResolutionTicks() - start, numSamples
+            );
+        }
+
+    private:
+        PerformanceMonitor& monitor;
+        int numSamples;
+        juce::int64 start;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedMeasurement)
+    };
+
+    // Reader side, a single thread only. Switches to the most recently
+    // published window and returns true if there was a new one.
+    bool update() { return published.update(); }
+    const PerformanceStats& getStats() const {
+        return published.getReadBuffer();
+    }
+
+private:
+    static constexpr int numBins = 400;
+    static constexpr double binsPerLoad = 200.0;
+    static constexpr double windowSeconds = 0.25;
+
+    void record(juce::int64 ticks, int numSamples);
+    void publish();
+
+    double sampleRate = 44100.0;
+    double secondsPerTick = 0.0;
+
+    // Window being collected, audio thread only.
+    std::array<int, numBins> histogram{};
+    double loadSum = 0.0;
+    double maxLoad = 0.0;
+    int numBlocks = 0;
+    int overruns = 0;
+    juce::int64 windowSamples = 0;
+
+    juce::int64 totalOverruns = 0;
+    juce::int64 window = 0;
+
+    TripleBuffer<PerformanceStats> published;
+};
@@ -0,0 +1,32 @@
+#include "PerformanceOverlay.h"
+
+#include "FontManager.h"
+
+PerformanceOverlay::PerformanceOverlay(PerformanceMonitor& m)
+    : monitor(m), vBlank(this, [this] { refresh(); }) {
+    setInterceptsMouseClicks(false, false);
+}
+
+void PerformanceOverlay::refresh() {
+    if (monitor.update()) repaint();
+}
+
+void PerformanceOverlay::paint(juce::Graphics& g) {
+    const auto& stats = monitor.getStats();
+    if (stats.window == 0) return;
+
+    auto percent = [](double load) {
+        return juce::String(load * 100.0, 1) + "%";
+    };
+
+    auto text = "CPU " + percent(stats.meanLoad) + " avg, "
+        + percent(stats.p99Load) + " p99, " + percent(stats.maxLoad)
+        + " max, " + juce::String(stats.totalOverruns) + " overruns";
+
+    g.setColour(
+        stats.overruns > 0 ? juce::Colour::fromRGB(0xe8, 0x5d, 0x00)
+                           : juce::Colour::fromRGB(0x88, 0x88, 0x88)
+    );
+    g.setFont(FontManager::getFont("GemunuLibre-Light", 12.0f));
+    g.drawText(text, getLocalBounds(), juce::Justification::centredRight);
+}
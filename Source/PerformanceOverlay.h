@@ -0,0 +1,19 @@
+#pragma once
+
+#include "PerformanceMonitor.h"
+#include <JuceHeader.h>
+
+// One line readout of the processor's callback load, checked for a new
+// window on every display refresh.
+class PerformanceOverlay : public juce::Component {
+public:
+    PerformanceOverlay(PerformanceMonitor& monitor);
+
+    void paint(juce::Graphics& g) override;
+
+private:
+    void refresh();
+
+    PerformanceMonitor& monitor;
+    juce::VBlankAttachment vBlank;
+};
@@ -1,7 +1,6 @@
 #include "PluginEditor.h"
 
 #include "FontManager.h"
-#include "NoisatLookAndFeel.h"
 #include "PluginProcessor.h"
 
 GeneralControlsPanel::GeneralControlsPanel(NoisatAudioProcessor& audioProcessor)
@@ -134,17 +133,21 @@ void NoiseControlPanel::resized() {
 
 NoisatAudioProcessorEditor::NoisatAudioProcessorEditor(NoisatAudioProcessor& p)
     : AudioProcessorEditor(&p), audioProcessor(p), generalControlsPanel(p),
-      noiseControlPanel(p), clipControlPanel(p) {
-    setLookAndFeel(new NoisatLookAndFeel());
+      noiseControlPanel(p), clipControlPanel(p),
+      performanceOverlay(p.performance) {
+    setLookAndFeel(&lookAndFeel);
 
     addAndMakeVisible(generalControlsPanel);
     addAndMakeVisible(clipControlPanel);
     addAndMakeVisible(noiseControlPanel);
+    addAndMakeVisible(performanceOverlay);
 
-    setSize(600, 150);
+    setSize(600, 166);
 }
 
-NoisatAudioProcessorEditor::~NoisatAudioProcessorEditor() {}
+NoisatAudioProcessorEditor::~NoisatAudioProcessorEditor() {
+    setLookAndFeel(nullptr);
+}
 
 void NoisatAudioProcessorEditor::paint(juce::Graphics& g) {
     g.fillAll(juce::Colour::fromRGB(0x11, 0x11, 0x11));
@@ -152,6 +155,7 @@ void NoisatAudioProcessorEditor::paint(juce::Graphics& g) {
 
 void NoisatAudioProcessorEditor::resized() {
     auto area = getLocalBounds();
+    performanceOverlay.setBounds(area.removeFromBottom(16).reduced(6, 0));
 
     generalControlsPanel.setBounds(area.removeFromLeft(80));
     noiseControlPanel.setBounds(area.removeFromLeft(250));
@@ -2,7 +2,9 @@
 
 #include "ClippingCurve.h"
 #include "NoiseColorEditor.h"
+#include "NoisatLookAndFeel.h"
 #include "Panel.h"
+#include "PerformanceOverlay.h"
 #include "PluginProcessor.h"
 #include <JuceHeader.h>
 
@@ -78,9 +80,13 @@ private:
     // access the processor object that created it.
     NoisatAudioProcessor& audioProcessor;
 
+    // Outlives every child, which all draw with it.
+    NoisatLookAndFeel lookAndFeel;
+
     GeneralControlsPanel generalControlsPanel;
     ClipControlPanel clipControlPanel;
     NoiseControlPanel noiseControlPanel;
+    PerformanceOverlay performanceOverlay;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NoisatAudioProcessorEditor)
 };
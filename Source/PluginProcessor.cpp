@@ -1,6 +1,10 @@
 #include "PluginProcessor.h"
 
+// Command line tools build the processor with NOISAT_HEADLESS=1, without the
+// editor sources or the plugin wrapper.
+#if !NOISAT_HEADLESS
 #include "PluginEditor.h"
+#endif
 
 DoubleIIR::DoubleIIR() {
     juce::NormalisableRange<float> expRange{};
@@ -67,96 +71,252 @@ DoubleIIR::DoubleIIR() {
     lpQ = new juce::AudioParameterFloat(
         "noiseLpQ", "Noise Lowpass Q", noiseQRange, 1.0f
     );
-
-    hpFreq->addListener(this);
-    hpQ->addListener(this);
-    lpFreq->addListener(this);
-    lpQ->addListener(this);
 }
 
-DoubleIIR::~DoubleIIR() {
-    hpFreq->removeListener(this);
-    hpQ->removeListener(this);
-    lpFreq->removeListener(this);
-    lpQ->removeListener(this);
+void DoubleIIR::prepare(double rate) { sampleRate = rate; }
+
+noisat::core::NoiseFilterSettings DoubleIIR::getSettings() const {
+    noisat::core::NoiseFilterSettings settings;
+    settings.hpFreq = hpFreq->get();
+    settings.hpQ = hpQ->get();
+    settings.lpFreq = lpFreq->get();
+    settings.lpQ = lpQ->get();
+    return settings;
 }
 
-void DoubleIIR::parameterValueChanged(int parameterIndex, float newValue) {
-    if (juce::MessageManager::getInstance()->isThisTheMessageThread()) {
-        cancelPendingUpdate();
-        handleAsyncUpdate();
-    } else {
-        triggerAsyncUpdate();
-    }
+void DoubleIIR::getPowerResponse(
+    const noisat::core::FrequencyGrid& grid, double* power
+) const {
+    auto rate = grid.sampleRate;
+    auto hp = BiquadCoefficients::makeHighPass(rate, hpFreq->get(), hpQ->get());
+    auto lp = BiquadCoefficients::makeLowPass(rate, lpFreq->get(), lpQ->get());
+
+    std::fill(power, power + grid.size(), 1.0);
+    noisat::core::applyPowerResponse(hp, grid, power);
+    noisat::core::applyPowerResponse(lp, grid, power);
 }
 
-void DoubleIIR::handleAsyncUpdate() {
-    lpCoeffs = juce::dsp::IIR::Coefficients<float>::makeLowPass(
-        spec.sampleRate, lpFreq->get(), lpQ->get()
+Clipper::Clipper() {
+    threshold = new juce::AudioParameterFloat(
+        "clipThres", "Clipping Threshold", 0.1f, 1.0f, 1.0f
+    );
+    knee = new juce::AudioParameterFloat(
+        "clipKnee", "Clipping Knee", 0.0f, 1.0f, 1.0f
     );
-    hpCoeffs = juce::dsp::IIR::Coefficients<float>::makeHighPass(
-        spec.sampleRate, hpFreq->get(), hpQ->get()
+    ratio = new juce::AudioParameterFloat(
+        "clipRatio", "Clipping Ratio", 1.0f, 40.0f, 1.0f
     );
+    custom = new juce::AudioParameterBool(
+        "clipCustom", "Custom Clipping Curve", false
+    );
+}
 
-    lpFilter.coefficients = lpCoeffs;
-    hpFilter.coefficients = hpCoeffs;
+Clipper::Shape Clipper::getShape() const {
+    return Shape(threshold->get(), knee->get(), ratio->get());
 }
 
-float DoubleIIR::processSample(float sample) {
-    sample = lpFilter.processSample(sample);
-    sample = hpFilter.processSample(sample);
-    return sample;
+float Clipper::evaluate(float sample) const {
+    float result;
+    process(&sample, &result, 1);
+    return result;
 }
 
-void DoubleIIR::prepare(juce::dsp::ProcessSpec sp) {
-    spec = sp;
-    hpFilter.prepare(sp);
-    lpFilter.prepare(sp);
+void Clipper::process(const float* in, float* out, size_t numSamples) const {
+    process(getShape(), in, out, numSamples);
+}
+
+Multiband::Multiband() {
+    numBands = new juce::AudioParameterInt("bands", "Bands", 1, maxBands, 1);
+
+    // Centred on the geometric mean of the range.
+    juce::NormalisableRange<float> frequencyRange{ 20.0f, 20000.0f };
+    frequencyRange.setSkewForCentre(632.0f);
+
+    noisat::core::MultibandSettings defaults;
+    for (size_t i = 0; i < crossovers.size(); i++) {
+        auto number = juce::String((int)i + 1);
+        crossovers[i] = new juce::AudioParameterFloat(
+            "crossover" + number,
+            "Crossover " + number,
+            frequencyRange,
+            defaults.crossovers[i]
+        );
+    }
+
+    for (size_t i = 0; i < bands.size(); i++) {
+        auto id = "band" + juce::String((int)i + 1);
+        auto name = "Band " + juce::String((int)i + 1) + " ";
+        auto& band = bands[i];
+
+        band.threshold = new juce::AudioParameterFloat(
+            id + "Thres", name + "Clipping Threshold", 0.1f, 1.0f, 1.0f
+        );
+        band.knee = new juce::AudioParameterFloat(
+            id + "Knee", name + "Clipping Knee", 0.0f, 1.0f, 1.0f
+        );
+        band.ratio = new juce::AudioParameterFloat(
+            id + "Ratio", name + "Clipping Ratio", 1.0f, 40.0f, 1.0f
+        );
+        band.noiseThres = new juce::AudioParameterFloat(
+            id + "NoiseThres", name + "Noise Threshold", 0.01f, 1.0f, 0.5f
+        );
+    }
+}
+
+noisat::core::MultibandSettings Multiband::getSettings() const {
+    noisat::core::MultibandSettings settings;
+    settings.numBands = numBands->get();
+
+    for (size_t i = 0; i < crossovers.size(); i++) {
+        settings.crossovers[i] = crossovers[i]->get();
+    }
+    for (size_t i = 0; i < bands.size(); i++) {
+        auto& band = settings.bands[i];
+        band.clipThres = bands[i].threshold->get();
+        band.clipKnee = bands[i].knee->get();
+        band.clipRatio = bands[i].ratio->get();
+        band.noiseThreshold = bands[i].noiseThres->get();
+    }
 
-    handleAsyncUpdate();
+    return settings;
 }
 
-void DoubleIIR::getMagnitude(
-    const double* frequencies, double* magnitudes, size_t numSamples
+void SmoothedParameters::prepare(
+    double sampleRate, int maxBlockSize, bool doublePrecision,
+    const ParameterSnapshot& initial
 ) {
-    std::vector<double> hpResponse(numSamples);
-    std::vector<double> lpResponse(numSamples);
+    for (auto& value : values) {
+        value.reset(sampleRate, 0.02);
+    }
 
-    hpCoeffs.get()->getMagnitudeForFrequencyArray(
-        frequencies, hpResponse.data(), numSamples, spec.sampleRate
+    std::get<juce::AudioBuffer<float>>(ramps).setSize(
+        numSmoothed, doublePrecision ? 0 : maxBlockSize
     );
-    lpCoeffs.get()->getMagnitudeForFrequencyArray(
-        frequencies, lpResponse.data(), numSamples, spec.sampleRate
+    std::get<juce::AudioBuffer<double>>(ramps).setSize(
+        numSmoothed, doublePrecision ? maxBlockSize : 0
     );
 
-    // TODO: Could be SIMDed...
-    for (size_t i = 0; i < numSamples; i++) {
-        magnitudes[i] = hpResponse[i] * lpResponse[i];
+    setTargets(initial);
+    for (auto& value : values) {
+        value.setCurrentAndTargetValue(value.getTargetValue());
     }
 }
 
-Clipper::Clipper() {
-    threshold = new juce::AudioParameterFloat(
-        "clipThres", "Clipping Threshold", 0.1f, 1.0f, 1.0f
-    );
-    knee = new juce::AudioParameterFloat(
-        "clipKnee", "Clipping Knee", 0.0f, 1.0f, 1.0f
-    );
-    ratio = new juce::AudioParameterFloat(
-        "clipRatio", "Clipping Ratio", 1.0f, 40.0f, 1.0f
+void SmoothedParameters::setTargets(const ParameterSnapshot& snapshot) {
+    values[preGain].setTargetValue(snapshot.preGain);
+    values[postGain].setTargetValue(snapshot.postGain);
+    values[dryWet].setTargetValue(snapshot.dryWet);
+    values[clipThres].setTargetValue(snapshot.clipThres);
+    values[clipKnee].setTargetValue(snapshot.clipKnee);
+    values[clipRatio].setTargetValue(snapshot.clipRatio);
+
+    const auto& multiband = snapshot.multiband;
+    for (int band = 0; band < maxBands; band++) {
+        const auto& settings = multiband.bands[(size_t)band];
+        values[bandClipThres + band].setTargetValue(settings.clipThres);
+        values[bandClipKnee + band].setTargetValue(settings.clipKnee);
+        values[bandClipRatio + band].setTargetValue(settings.clipRatio);
+        values[bandNoiseThres + band].setTargetValue(settings.noiseThreshold);
+    }
+    for (int split = 0; split < maxBands - 1; split++) {
+        values[crossover + split].setTargetValue(
+            multiband.crossovers[(size_t)split]
+        );
+    }
+}
+
+bool SmoothedParameters::isSmoothing() const {
+    for (auto& value : values) {
+        if (value.isSmoothing()) return true;
+    }
+    return false;
+}
+
+template <typename SampleType>
+void SmoothedParameters::renderRamps(int numSamples) {
+    auto& buffer = std::get<juce::AudioBuffer<SampleType>>(ramps);
+    jassert(numSamples <= buffer.getNumSamples());
+
+    for (int index = 0; index < numSmoothed; index++) {
+        auto& value = values[index];
+        auto* ramp = buffer.getWritePointer(index);
+
+        if (!value.isSmoothing()) {
+            juce::FloatVectorOperations::fill(
+                ramp, (SampleType)value.getTargetValue(), numSamples
+            );
+            continue;
+        }
+
+        for (int i = 0; i < numSamples; i++) {
+            ramp[i] = (SampleType)value.getNextValue();
+        }
+    }
+}
+
+template <typename SampleType>
+void InputHistory<SampleType>::prepare(int numChannels, int capacity) {
+    samples.setSize(numChannels, capacity);
+    samples.clear();
+    writePosition = 0;
+}
+
+template <typename SampleType>
+void InputHistory<SampleType>::push(
+    const juce::AudioBuffer<SampleType>& buffer, int numSamples
+) {
+    auto capacity = samples.getNumSamples();
+    jassert(numSamples <= capacity);
+
+    auto first = std::min(numSamples, capacity - writePosition);
+    for (int channel = 0; channel < samples.getNumChannels(); channel++) {
+        samples.copyFrom(channel, writePosition, buffer, channel, 0, first);
+        samples.copyFrom(
+            channel, 0, buffer, channel, first, numSamples - first
+        );
+    }
+
+    writePosition = (writePosition + numSamples) % capacity;
+}
+
+template <typename SampleType>
+void InputHistory<SampleType>::read(
+    int channel, int age, SampleType* destination, int numSamples
+) const {
+    auto capacity = samples.getNumSamples();
+    jassert(age <= capacity && numSamples <= age);
+
+    auto start = (writePosition - age + capacity) % capacity;
+    auto first = std::min(numSamples, capacity - start);
+    const auto* source = samples.getReadPointer(channel);
+
+    juce::FloatVectorOperations::copy(destination, source + start, first);
+    juce::FloatVectorOperations::copy(
+        destination + first, source, numSamples - first
     );
 }
 
-float Clipper::evaluate(float sample) {
-    auto kneeValue = knee->get();
-    auto ratioValue = ratio->get();
-    auto thresValue = threshold->get();
+template <typename SampleType>
+void ProcessingBuffers<SampleType>::prepare(
+    int numChannels, int maxBlockSize, int maxOversampledBlockSize,
+    int historyLength, int warmUpLength
+) {
+    noise.setSize(numChannels, maxOversampledBlockSize);
+    channels.assign((size_t)numChannels, nullptr);
+    transition.setSize(numChannels, maxOversampledBlockSize);
 
-    if (sample <= thresValue) return sample;
-    sample = (sample - thresValue) / (1 - thresValue);
-    return (sample * std::exp(-kneeValue * sample) / ratioValue)
-        * (1 - thresValue)
-        + thresValue;
+    history.prepare(numChannels, historyLength);
+    bypass.setSize(numChannels, maxBlockSize);
+    warmUp.setSize(numChannels, std::min(maxBlockSize, warmUpLength));
+}
+
+template <typename SampleType> void ProcessingBuffers<SampleType>::release() {
+    noise.setSize(0, 0);
+    channels = {};
+    transition.setSize(0, 0);
+    history.prepare(0, 0);
+    bypass.setSize(0, 0);
+    warmUp.setSize(0, 0);
 }
 
 //==============================================================================
@@ -169,6 +329,9 @@ NoisatAudioProcessor::NoisatAudioProcessor()
     noiseThres = new juce::AudioParameterFloat(
         "noiseThres", "Noise Threshold", 0.01f, 1.0f, 0.5f
     );
+    noiseCorrelation = new juce::AudioParameterFloat(
+        "noiseCorrelation", "Noise Stereo Correlation", 0.0f, 1.0f, 0.0f
+    );
 
     preGain =
         new juce::AudioParameterFloat("preGain", "Pre-Gain", 0.0f, 5.0f, 1.0f);
@@ -177,6 +340,13 @@ NoisatAudioProcessor::NoisatAudioProcessor()
     );
     dryWet = new juce::AudioParameterFloat("dryWet", "Mix", 0.0f, 1.0f, 1.0f);
 
+    truePeak = new juce::AudioParameterBool(
+        "truePeak", "True Peak Ceiling", false
+    );
+    truePeakCeiling = new juce::AudioParameterFloat(
+        "truePeakCeiling", "True Peak Ceiling Level", -12.0f, 0.0f, -1.0f
+    );
+
     addParameter(noiseEq.hpQ);
     addParameter(noiseEq.hpFreq);
     addParameter(noiseEq.lpQ);
@@ -190,13 +360,40 @@ NoisatAudioProcessor::NoisatAudioProcessor()
     addParameter(preGain);
     addParameter(postGain);
     addParameter(dryWet);
+
+    addParameter(clipper.custom);
+    addParameter(noiseCorrelation);
+    addParameter(noiseTable.enabled);
+    addParameter(oversampler.factor);
+    addParameter(oversampler.filter);
+
+    addParameter(multiband.numBands);
+    for (auto* crossover : multiband.crossovers) {
+        addParameter(crossover);
+    }
+    for (auto& band : multiband.bands) {
+        addParameter(band.threshold);
+        addParameter(band.knee);
+        addParameter(band.ratio);
+        addParameter(band.noiseThres);
+    }
+
+    addParameter(truePeak);
+    addParameter(truePeakCeiling);
+    oversampler.setLookAheadSwitch(truePeak);
+
+    seed = (juce::uint64)juce::Random::getSystemRandom().nextInt64();
 }
 
 NoisatAudioProcessor::~NoisatAudioProcessor() {}
 
 //==============================================================================
 const juce::String NoisatAudioProcessor::getName() const {
+#ifdef JucePlugin_Name
     return JucePlugin_Name;
+#else
+    return "Noisat";
+#endif
 }
 
 bool NoisatAudioProcessor::acceptsMidi() const {
@@ -226,17 +423,39 @@ bool NoisatAudioProcessor::isMidiEffect() const {
 double NoisatAudioProcessor::getTailLengthSeconds() const { return 0.0; }
 
 int NoisatAudioProcessor::getNumPrograms() {
-    return 1; // NB: some hosts don't cope very well if you tell them there are
-              // 0 programs, so this should be at least 1, even if you're not
-              // really implementing programs.
+    return (int)Preset::getFactoryPresets().size();
 }
 
-int NoisatAudioProcessor::getCurrentProgram() { return 0; }
+int NoisatAudioProcessor::getCurrentProgram() { return currentProgram; }
 
-void NoisatAudioProcessor::setCurrentProgram(int index) {}
+void NoisatAudioProcessor::setCurrentProgram(int index) {
+    const auto& presets = Preset::getFactoryPresets();
+    if (index < 0 || index >= (int)presets.size()) return;
+
+    auto state = getState();
+    for (size_t i = 0; i < PluginState::numValues; i++) {
+        auto id = PluginState::parameterIds[i];
+        auto* parameter = findParameter(id);
+        if (parameter == nullptr || !Preset::isSoundParameter(id)) continue;
+
+        state.values[i] =
+            parameter->convertFrom0to1(parameter->getDefaultValue());
+    }
+
+    for (const auto& [id, value] : presets[(size_t)index].values) {
+        auto i = PluginState::indexOf(id);
+        jassert(i >= 0);
+        if (i >= 0) state.values[(size_t)i] = value;
+    }
+
+    state.program = index;
+    setState(state);
+}
 
 const juce::String NoisatAudioProcessor::getProgramName(int index) {
-    return {};
+    const auto& presets = Preset::getFactoryPresets();
+    if (index < 0 || index >= (int)presets.size()) return {};
+    return presets[(size_t)index].name;
 }
 
 void NoisatAudioProcessor::changeProgramName(
@@ -247,22 +466,83 @@ void NoisatAudioProcessor::changeProgramName(
 void NoisatAudioProcessor::prepareToPlay(
     double sampleRate, int samplesPerBlock
 ) {
-    size_t numCh =
+    numChannels =
         std::max(getTotalNumOutputChannels(), getTotalNumInputChannels());
 
-    oversampling = std::make_unique<juce::dsp::Oversampling<float>>(
-        numCh,
-        oversamplingFactor,
-        juce::dsp::Oversampling<float>::FilterType::filterHalfBandPolyphaseIIR
-    );
-    oversampling->initProcessing(samplesPerBlock * (1 << oversamplingFactor));
+    oversampler.prepare(numChannels, samplesPerBlock, sampleRate);
+    performance.prepare(sampleRate);
+    analyzer.prepare(sampleRate, numChannels, samplesPerBlock);
+
+    // The history has room for the current block, the warm-up run before it
+    // and the longest oversampling latency.
+    maxOversampledBlockSize = samplesPerBlock * Oversampler::maxFactor;
+    auto historyLength = samplesPerBlock + warmUpLength + 4096;
+
+    if (isUsingDoublePrecision()) {
+        floatBuffers.release();
+        doubleBuffers.prepare(
+            numChannels,
+            samplesPerBlock,
+            maxOversampledBlockSize,
+            historyLength,
+            warmUpLength
+        );
+    } else {
+        doubleBuffers.release();
+        floatBuffers.prepare(
+            numChannels,
+            samplesPerBlock,
+            maxOversampledBlockSize,
+            historyLength,
+            warmUpLength
+        );
+    }
+    bypassed = false;
+    silentLength = 0;
+    filtersCleared = false;
+    position = 0;
+
+    prepareOversampledRate();
+}
 
+void NoisatAudioProcessor::prepareOversampledRate() {
+    // Called again from the audio thread whenever the oversampling factor
+    // changes. Every size passed here is already allocated by then.
     juce::dsp::ProcessSpec spec;
-    spec.sampleRate = sampleRate * (1 << oversamplingFactor);
-    spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = getNumInputChannels();
+    spec.sampleRate = oversampler.getOversampledRate();
+    spec.maximumBlockSize = (juce::uint32)maxOversampledBlockSize;
+    spec.numChannels = (juce::uint32)numChannels;
+
+    auto params = getParameterSnapshot();
+
+    noiseEq.prepare(spec.sampleRate);
+    smoothed.prepare(
+        spec.sampleRate,
+        maxOversampledBlockSize,
+        isUsingDoublePrecision(),
+        params
+    );
+    engine.prepare(
+        spec.sampleRate,
+        numChannels,
+        maxOversampledBlockSize,
+        isUsingDoublePrecision(),
+        params
+    );
+    noiseTable.prepare(spec.sampleRate, numChannels, maxOversampledBlockSize);
+    bands.prepare(spec.sampleRate, numChannels);
+    transitionBands.prepare(spec.sampleRate, numChannels);
+    ceiling.prepare(
+        spec.sampleRate,
+        oversampler.getFactor(),
+        Oversampler::maxFactor,
+        numChannels
+    );
 
-    noiseEq.prepare(spec);
+    adoptedSequence = stateSequence.load(std::memory_order_acquire);
+    adoptedParams = params;
+    transitionLength = 0;
+    transitionPosition = 0;
 }
 
 void NoisatAudioProcessor::releaseResources() {
@@ -278,15 +558,10 @@ bool NoisatAudioProcessor::isBusesLayoutSupported(
     juce::ignoreUnused(layouts);
     return true;
 #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-        && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
-        return false;
+    // Any main bus layout works as long as the input matches the output:
+    // apart from the correlated noise, every channel is processed on its own.
+    if (layouts.getMainOutputChannelSet().isDisabled()) return false;
 
-    // This checks if the input layout matches the output layout
 #if !JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
@@ -297,10 +572,137 @@ bool NoisatAudioProcessor::isBusesLayoutSupported(
 }
 #endif
 
+namespace {
+// Time constant of the slowest pole of a second order section. Above a Q of
+// 0.5 both poles decay at the same rate, below it one gets slower and slower.
+double getTimeConstant(double frequency, double q) {
+    auto damping = 0.5 / q;
+    auto rate = damping - std::sqrt(std::max(0.0, damping * damping - 1.0));
+    return 1.0 / (juce::MathConstants<double>::twoPi * frequency * rate);
+}
+} // namespace
+
+double NoisatAudioProcessor::getSettlingSeconds() const {
+    // The noise filters are the slowest at their lowest frequencies, with a
+    // time constant of 2Q/w0 at high Q, over three seconds at 4 Hz and a Q
+    // of 40. The gain of the ceiling and the crossovers of the bands recover
+    // in far less.
+    auto slowest = std::max(
+        getTimeConstant(noiseEq.hpFreq->get(), noiseEq.hpQ->get()),
+        getTimeConstant(noiseEq.lpFreq->get(), noiseEq.lpQ->get())
+    );
+    slowest = std::max(slowest, noisat::core::TruePeakCeiling::releaseSeconds);
+
+    // Each crossover is a pair of Butterworth sections.
+    auto split = multiband.getSettings();
+    for (int i = 0; i < split.numBands - 1; i++) {
+        auto frequency = (double)split.crossovers[(size_t)i];
+        slowest = std::max(slowest, getTimeConstant(frequency, std::sqrt(0.5)));
+    }
+
+    // Sections sharing a pole, like the two of a Linkwitz-Riley crossover,
+    // take a few time constants longer. The oversampling filters settle
+    // within a few milliseconds.
+    auto timeConstants = std::log(1.0 / settlingTolerance) + 3.0;
+    return slowest * timeConstants + 0.1;
+}
+
+ParameterSnapshot NoisatAudioProcessor::getParameterSnapshot() const {
+    ParameterSnapshot snapshot;
+
+    snapshot.noiseThreshold = noiseThres->get();
+    snapshot.noiseCorrelation = noiseCorrelation->get();
+    snapshot.noiseTable = noiseTable.enabled->get();
+    snapshot.noiseFilter = noiseEq.getSettings();
+    snapshot.preGain = preGain->get();
+    snapshot.postGain = postGain->get();
+    snapshot.dryWet = dryWet->get();
+    snapshot.clipThres = clipper.threshold->get();
+    snapshot.clipKnee = clipper.knee->get();
+    snapshot.clipRatio = clipper.ratio->get();
+    snapshot.clipCustom = clipper.custom->get();
+    snapshot.multiband = multiband.getSettings();
+    snapshot.truePeak = truePeak->get();
+    snapshot.truePeakCeiling =
+        juce::Decibels::decibelsToGain(truePeakCeiling->get());
+    snapshot.seed = seed.load();
+
+    return snapshot;
+}
+
+ParameterSnapshot NoisatAudioProcessor::adoptParameterSnapshot() {
+    auto sequence = stateSequence.load(std::memory_order_acquire);
+    auto params = getParameterSnapshot();
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // setState() is still busy, or was while the snapshot was taken.
+    if ((sequence & 1) != 0
+        || stateSequence.load(std::memory_order_relaxed) != sequence) {
+        return adoptedParams;
+    }
+
+    if (sequence != adoptedSequence) {
+        adoptedSequence = sequence;
+        transitionFrom = adoptedParams;
+        transitionLength =
+            (int)(oversampler.getOversampledRate() * transitionSeconds);
+        transitionPosition = 0;
+        transitionBands = bands;
+
+        const auto& table = transferCurve.getLastTable();
+        transitionFromTable = nullptr;
+        if (transitionFrom.clipCustom && table.custom) {
+            transitionTable = table;
+            transitionFromTable = &transitionTable;
+        }
+    }
+
+    adoptedParams = params;
+    return params;
+}
+
+juce::RangedAudioParameter*
+NoisatAudioProcessor::findParameter(const juce::String& id) const {
+    for (auto* parameter : getParameters()) {
+        auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter);
+        if (ranged != nullptr && ranged->paramID == id) return ranged;
+    }
+    return nullptr;
+}
+
 void NoisatAudioProcessor::processBlock(
     juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages
 ) {
+    process(buffer);
+}
+
+void NoisatAudioProcessor::processBlock(
+    juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages
+) {
+    process(buffer);
+}
+
+template <typename SampleType>
+void NoisatAudioProcessor::process(juce::AudioBuffer<SampleType>& buffer) {
     juce::ScopedNoDenormals noDenormals;
+
+    // Hosts may block the message thread while rendering offline, which
+    // would hold back every rebuild the audio thread waits for. There is time
+    // to run them right here then, ahead of the part of the block that must
+    // not allocate: they build stages and tables, and wait for the noise
+    // table to render.
+    if (isNonRealtime()) {
+        transferCurve.updateNowIfNeeded();
+        oversampler.updateNowIfNeeded();
+        if (oversampler.update()) prepareOversampledRate();
+        noiseTable.renderNowIfNeeded();
+    }
+
+    ScopedNoAllocations noAllocations;
+    PerformanceMonitor::ScopedMeasurement measurement{
+        performance, buffer.getNumSamples()
+    };
+
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -313,83 +715,608 @@ void NoisatAudioProcessor::processBlock(
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear(i, 0, buffer.getNumSamples());
 
-    auto noiseThreshold = noiseThres->get();
-    auto preGainFactor = preGain->get();
-    auto postGainFactor = postGain->get();
-    auto dryWetFactor = dryWet->get();
+    if (oversampler.update()) prepareOversampledRate();
+
+    auto& oversampling = oversampler.getStage<SampleType>();
+    auto& buffers = getBuffers<SampleType>();
+
+    auto params = adoptParameterSnapshot();
+    smoothed.setTargets(params);
+
+    auto hostNumSamples = buffer.getNumSamples();
+    buffers.history.push(buffer, hostNumSamples);
+
+    auto blockPosition = position;
+    position += hostNumSamples;
+
+    bool analyse = analyzer.isEnabled();
+    if (analyse) {
+        analyzer.push(SpectrumAnalyzer::input, buffer, hostNumSamples, 1);
+    }
 
-    juce::dsp::AudioBlock<float> inputBlock{ buffer };
-    juce::dsp::ProcessContextReplacing<float> inputContext{ inputBlock };
+    // Below the threshold, the linear phase filters are skipped along with
+    // everything in between. The IIR ones keep running, so that their state
+    // and phase stay continuous, and only what runs at the oversampled rate
+    // is skipped, with no fade needed.
+    auto peak = getPeak(buffer);
+    bool belowThreshold = canBypass((float)peak, params);
+    bool linearPhase = oversampler.hasLinearPhase();
+    bool bypass = belowThreshold && linearPhase;
+    bool quiet = belowThreshold && !linearPhase;
+
+    bool silent = quiet && peak == 0 && !smoothed.isSmoothing();
+    silentLength = silent ? silentLength + hostNumSamples : 0;
+    filtersCleared = filtersCleared && silent;
+    if (filtersCleared) {
+        for (int ch = 0; ch < numChannels; ch++) {
+            buffer.clear(ch, 0, hostNumSamples);
+        }
+        if (analyse) {
+            auto factor = oversampler.getFactor();
+            analyzer.pushSilence(
+                SpectrumAnalyzer::noise, hostNumSamples * factor, factor
+            );
+            analyzer.push(SpectrumAnalyzer::output, buffer, hostNumSamples, 1);
+        }
+        return;
+    }
+
+    if (bypass && bypassed) {
+        transitionPosition = transitionLength;
+
+        // Like the noise filters, the ceiling starts again after a gap, so
+        // that its state only depends on what it has seen since: the input
+        // replayed on the way back, and the blocks after that.
+        ceiling.reset();
+
+        if (smoothed.isSmoothing()) {
+            smoothed.renderRamps<SampleType>(
+                hostNumSamples * oversampler.getFactor()
+            );
+            processBypassed<SampleType, true>(hostNumSamples, params);
+        } else {
+            processBypassed<SampleType, false>(hostNumSamples, params);
+        }
+
+        for (int ch = 0; ch < buffers.bypass.getNumChannels(); ch++) {
+            buffer.copyFrom(ch, 0, buffers.bypass, ch, 0, hostNumSamples);
+        }
+
+        if (analyse) {
+            auto factor = oversampler.getFactor();
+            analyzer.pushSilence(
+                SpectrumAnalyzer::noise, hostNumSamples * factor, factor
+            );
+            analyzer.push(SpectrumAnalyzer::output, buffer, hostNumSamples, 1);
+        }
+        return;
+    }
+
+    if (bypassed) {
+        warmUpOversampling<SampleType>(
+            hostNumSamples, (juce::uint64)blockPosition, params
+        );
+    }
+
+    juce::dsp::AudioBlock<SampleType> inputBlock{ buffer };
+    juce::dsp::ProcessContextReplacing<SampleType> inputContext{ inputBlock };
 
     auto oversampledBlock =
-        oversampling->processSamplesUp(inputContext.getInputBlock());
-    auto numSamples = oversampledBlock.getNumSamples();
+        oversampling.processSamplesUp(inputContext.getInputBlock());
+
+    bool isSmoothing = smoothed.isSmoothing();
+    if (isSmoothing) {
+        smoothed.renderRamps<SampleType>(
+            (int)oversampledBlock.getNumSamples()
+        );
+    }
+    auto noisePosition =
+        (juce::uint64)blockPosition * (juce::uint64)oversampler.getFactor();
+    if (quiet) {
+        processQuiet(oversampledBlock, params, isSmoothing, noisePosition);
+    } else {
+        processOversampled(
+            oversampledBlock, params, isSmoothing, noisePosition
+        );
+    }
+
+    inputContext.getOutputBlock().clear();
+
+    oversampling.processSamplesDown(inputContext.getOutputBlock());
+
+    // Denormals are flushed, so the filters ring out to exactly zero. Once
+    // the output is, past their latency and a margin, clearing them changes
+    // nothing, and the silence that follows skips them.
+    auto tailLength = oversampler.getLatency() + silenceTailLength;
+    if (silent && silentLength >= tailLength && getPeak(buffer) == 0) {
+        oversampling.reset();
+        ceiling.reset();
+        filtersCleared = true;
+    }
+
+    // Entering or leaving the bypass: fade between both paths, reusing the
+    // ramps rendered for the oversampled path.
+    if (bypass != bypassed) {
+        if (isSmoothing) {
+            processBypassed<SampleType, true>(hostNumSamples, params);
+        } else {
+            processBypassed<SampleType, false>(hostNumSamples, params);
+        }
+        crossfadeWithBypass(buffer, hostNumSamples, bypass);
+        bypassed = bypass;
+    }
+
+    if (analyse) {
+        analyzer.push(SpectrumAnalyzer::output, buffer, hostNumSamples, 1);
+    }
+}
 
-    // TODO: Make member of the class to avoid unnecessary allocations?
-    // TODO: Stereo noise?
-    std::vector<float> noiseBuf(numSamples);
+template <typename SampleType>
+SampleType NoisatAudioProcessor::getPeak(
+    const juce::AudioBuffer<SampleType>& buffer
+) const {
+    SampleType peak = 0;
+    for (int ch = 0; ch < numChannels; ch++) {
+        auto range = juce::FloatVectorOperations::findMinAndMax(
+            buffer.getReadPointer(ch), buffer.getNumSamples()
+        );
+        peak = std::max({ peak, -range.getStart(), range.getEnd() });
+    }
+    return peak;
+}
 
-    for (int i = 0; i < numSamples; i++) {
-        float noise = noiseGen.nextFloat();
-        noise = noiseEq.processSample(noise);
-        noiseBuf[i] = noise;
+bool NoisatAudioProcessor::canBypass(
+    float peak, const ParameterSnapshot& params
+) const {
+    using Index = SmoothedParameters::Index;
+
+    // Headroom for inter-sample peaks between the samples scanned here,
+    // about 2 dB. Only the built-in curve is the identity below threshold.
+    constexpr float peakMargin = 1.26f;
+    if (params.clipCustom) return false;
+
+    // The crossover shifts the phase even where nothing is clipped.
+    if (params.multiband.isEnabled()) return false;
+
+    float preGainValue =
+        std::max(params.preGain, smoothed.getCurrentValue(Index::preGain));
+    float threshold = std::min(
+        params.clipThres, smoothed.getCurrentValue(Index::clipThres)
+    );
+
+    // The bypass path skips the ceiling as well, so the output has to stay
+    // below it on its own.
+    if (params.truePeak) {
+        float postGainValue = std::max(
+            params.postGain, smoothed.getCurrentValue(Index::postGain)
+        );
+        float outputPeak = peak * preGainValue * postGainValue;
+        if (outputPeak * peakMargin >= params.truePeakCeiling) return false;
     }
 
-    // TODO: Better range checking?
-    for (int channel = 0; channel < 2; ++channel) {
-        if (totalNumOutputChannels < channel) break;
+    return peak * preGainValue * peakMargin < threshold;
+}
+
+template <typename SampleType>
+void NoisatAudioProcessor::warmUpOversampling(
+    int numSamples, juce::uint64 blockPosition, const ParameterSnapshot& params
+) {
+    using Index = SmoothedParameters::Index;
+
+    // The oversampling filters have not seen the input since the bypass
+    // started. Replay the input that preceded this block through them, so
+    // that their state matches continuous processing again.
+    //
+    // The ceiling delays the signal, and what it puts out at the start of
+    // this block comes from the replayed input. Below the threshold, only
+    // the gains change that.
+    auto& oversampling = oversampler.getStage<SampleType>();
+    auto& buffers = getBuffers<SampleType>();
+    auto factor = (juce::uint64)oversampler.getFactor();
+    auto gain = (SampleType)(
+        smoothed.getCurrentValue(Index::preGain)
+        * smoothed.getCurrentValue(Index::postGain)
+    );
+    oversampling.reset();
+
+    auto chunkLength = buffers.warmUp.getNumSamples();
+    for (int done = 0; done < warmUpLength; done += chunkLength) {
+        auto length = std::min(chunkLength, warmUpLength - done);
+        auto age = numSamples + warmUpLength - done;
 
-        for (auto i = 0; i < numSamples; i++) {
-            float sample = oversampledBlock.getSample(channel, i);
-            sample *= preGainFactor;
-            float clipped = clipper.evaluate(sample);
+        for (int ch = 0; ch < numChannels; ch++) {
+            buffers.history.read(
+                ch, age, buffers.warmUp.getWritePointer(ch), length
+            );
+        }
 
-            float amountClipped = std::abs(clipped - sample);
-            if (amountClipped > noiseThreshold) {
-                clipped +=
-                    std::copysignf(amountClipped - noiseThreshold, clipped)
-                    * noiseBuf[i];
+        auto block = juce::dsp::AudioBlock<SampleType>(buffers.warmUp)
+                         .getSubBlock(0, (size_t)length);
+        auto oversampled = oversampling.processSamplesUp(block);
+
+        oversampled.multiplyBy(gain);
+        for (size_t ch = 0; ch < oversampled.getNumChannels(); ch++) {
+            buffers.channels[ch] = oversampled.getChannelPointer(ch);
+        }
+        auto start = blockPosition - (juce::uint64)(warmUpLength - done);
+        applyCeiling(
+            buffers.channels.data(),
+            (int)oversampled.getNumSamples(),
+            start * factor,
+            params
+        );
+
+        oversampling.processSamplesDown(block);
+    }
+}
+
+template <typename SampleType>
+void NoisatAudioProcessor::crossfadeWithBypass(
+    juce::AudioBuffer<SampleType>& buffer, int numSamples, bool toBypass
+) {
+    auto& bypassBuffer = getBuffers<SampleType>().bypass;
+    auto fadeLength = std::min(numSamples, bypassFadeLength);
+
+    for (int ch = 0; ch < numChannels; ch++) {
+        auto* out = buffer.getWritePointer(ch);
+        const auto* fast = bypassBuffer.getReadPointer(ch);
+
+        for (int i = 0; i < numSamples; i++) {
+            SampleType t = i < fadeLength
+                ? (SampleType)(i + 1) / (SampleType)fadeLength
+                : (SampleType)1;
+            SampleType weight = toBypass ? t : 1 - t;
+            out[i] += (fast[i] - out[i]) * weight;
+        }
+    }
+}
+
+template <typename SampleType, bool IsSmoothing>
+void NoisatAudioProcessor::processBypassed(
+    int numSamples, const ParameterSnapshot& params
+) {
+    using Index = SmoothedParameters::Index;
+
+    // Below the threshold the clipper passes the signal through unchanged,
+    // no noise is added and the mix makes no difference, so only the gains
+    // remain. Ramps run at the oversampled rate and are read at every
+    // `factor`th sample.
+    auto& buffers = getBuffers<SampleType>();
+    auto factor = oversampler.getFactor();
+    auto age = numSamples + oversampler.getLatency();
+
+    for (int ch = 0; ch < numChannels; ch++) {
+        auto* out = buffers.bypass.getWritePointer(ch);
+        buffers.history.read(ch, age, out, numSamples);
+
+        if constexpr (IsSmoothing) {
+            const auto* pre = smoothed.getRamp<SampleType>(Index::preGain);
+            const auto* post = smoothed.getRamp<SampleType>(Index::postGain);
+
+            for (int i = 0; i < numSamples; i++) {
+                out[i] *= pre[i * factor] * post[i * factor];
             }
+        } else {
+            juce::ignoreUnused(factor);
+            juce::FloatVectorOperations::multiply(
+                out, (SampleType)(params.preGain * params.postGain), numSamples
+            );
+        }
+    }
+}
 
-            float output =
-                sample * dryWetFactor + (1.0f - dryWetFactor) * clipped;
-            output *= postGainFactor;
+template <typename SampleType>
+void NoisatAudioProcessor::processQuiet(
+    juce::dsp::AudioBlock<SampleType>& block, const ParameterSnapshot& params,
+    bool isSmoothing, juce::uint64 noisePosition
+) {
+    using Index = SmoothedParameters::Index;
+
+    // As on the bypass path, only the gains remain below the threshold. The
+    // ceiling has nothing to hold either, but keeps delaying the signal
+    // while it looks ahead. A state change sounds the same as well, so any
+    // fade between states ends here, and the bands start from silence the
+    // next time they are switched on.
+    auto numSamples = (int)block.getNumSamples();
+    auto& buffers = getBuffers<SampleType>();
+    transitionPosition = transitionLength;
+    bands.reset();
+
+    for (size_t ch = 0; ch < block.getNumChannels(); ch++) {
+        auto* samples = block.getChannelPointer(ch);
+        buffers.channels[ch] = samples;
+
+        if (isSmoothing) {
+            juce::FloatVectorOperations::multiply(
+                samples,
+                smoothed.getRamp<SampleType>(Index::preGain),
+                numSamples
+            );
+            juce::FloatVectorOperations::multiply(
+                samples,
+                smoothed.getRamp<SampleType>(Index::postGain),
+                numSamples
+            );
+        } else {
+            juce::FloatVectorOperations::multiply(
+                samples,
+                (SampleType)(params.preGain * params.postGain),
+                numSamples
+            );
+        }
+    }
 
-            oversampledBlock.setSample(channel, i, output);
+    if (oversampler.hasLookAhead()) {
+        ceiling.process(
+            buffers.channels.data(),
+            numSamples,
+            noisePosition,
+            false,
+            params.truePeakCeiling
+        );
+    }
+
+    if (analyzer.isEnabled()) {
+        auto factor = oversampler.getFactor();
+        analyzer.pushSilence(SpectrumAnalyzer::noise, numSamples, factor);
+    }
+}
+
+template <typename SampleType>
+void NoisatAudioProcessor::processOversampled(
+    juce::dsp::AudioBlock<SampleType>& block, const ParameterSnapshot& params,
+    bool isSmoothing, juce::uint64 noisePosition
+) {
+    auto numSamples = (int)block.getNumSamples();
+    auto& buffers = getBuffers<SampleType>();
+
+    engine.setSeed(params.seed);
+    noiseTable.setSeed(params.seed);
+    engine.beginBlock(numSamples, params);
+    noiseTable.update();
+
+    // The custom curve is looked up once its table has arrived. The built-in
+    // curve, soft knee included, is cheaper to compute than to look up.
+    const auto& table = transferCurve.getTable();
+    bool useTable = params.clipCustom && table.custom;
+
+    // Most settings leave no room for noise, in which case none is made.
+    auto needsNoise = [](const ParameterSnapshot& p, bool ramping, bool table) {
+        if (p.multiband.isEnabled()) {
+            return noisat::core::MultibandClipper::needsNoise(p, ramping);
         }
+        return noisat::core::Engine::needsNoise(p, ramping, table);
+    };
+    bool withNoise = needsNoise(params, isSmoothing, params.clipCustom);
+
+    // While fading in a new state the old one is rendered alongside, from the
+    // same input and noise.
+    bool inTransition = transitionPosition < transitionLength;
+    const auto& from = transitionFrom;
+    const auto* fromTable = transitionFromTable;
+    if (inTransition && !withNoise) {
+        withNoise = needsNoise(from, false, fromTable != nullptr);
     }
-    inputContext.getOutputBlock().clear();
 
-    oversampling->processSamplesDown(inputContext.getOutputBlock());
+    if (withNoise && params.noiseTable && noiseTable.isReady()) {
+        noiseTable.read(
+            buffers.noise, numSamples, params.noiseCorrelation, noisePosition
+        );
+    } else if (withNoise) {
+        engine.renderNoise(
+            buffers.noise.getArrayOfWritePointers(),
+            numSamples,
+            params,
+            noisePosition
+        );
+    }
+
+    if (analyzer.isEnabled()) {
+        auto factor = oversampler.getFactor();
+        if (withNoise) {
+            analyzer.push(
+                SpectrumAnalyzer::noise, buffers.noise, numSamples, factor
+            );
+        } else {
+            analyzer.pushSilence(SpectrumAnalyzer::noise, numSamples, factor);
+        }
+    }
+
+    for (size_t channel = 0; channel < block.getNumChannels(); channel++) {
+        buffers.channels[channel] = block.getChannelPointer(channel);
+    }
+    const auto* const* noise =
+        withNoise ? buffers.noise.getArrayOfReadPointers() : nullptr;
+
+    if (inTransition) {
+        auto& fromBlock = buffers.transition;
+        for (int channel = 0; channel < numChannels; channel++) {
+            fromBlock.copyFrom(
+                channel, 0, block.getChannelPointer((size_t)channel), numSamples
+            );
+        }
+
+        if (from.multiband.isEnabled()) {
+            transitionBands.beginBlock(from.multiband);
+            transitionBands.process<SampleType>(
+                fromBlock.getArrayOfWritePointers(), noise, numSamples, from
+            );
+        } else {
+            engine.process<SampleType>(
+                fromBlock.getArrayOfWritePointers(),
+                noise,
+                numSamples,
+                from,
+                nullptr,
+                fromTable
+            );
+        }
+    }
+
+    auto ramps = smoothed.getRamps<SampleType>();
+    if (params.multiband.isEnabled()) {
+        auto bandRamps = smoothed.getBandRamps<SampleType>();
+        bands.beginBlock(params.multiband);
+        bands.process(
+            buffers.channels.data(),
+            noise,
+            numSamples,
+            params,
+            isSmoothing ? &ramps : nullptr,
+            isSmoothing ? &bandRamps : nullptr
+        );
+    } else {
+        // Switching the bands back on starts them from silence.
+        bands.reset();
+        engine.process(
+            buffers.channels.data(),
+            noise,
+            numSamples,
+            params,
+            isSmoothing ? &ramps : nullptr,
+            useTable ? &table : nullptr
+        );
+    }
+
+    if (inTransition) crossfadeTransition(block, numSamples);
+
+    // Last, so that it holds whatever the mix and the gains did.
+    applyCeiling(buffers.channels.data(), numSamples, noisePosition, params);
+}
+
+template <typename SampleType>
+void NoisatAudioProcessor::applyCeiling(
+    SampleType* const* channels, int numSamples, juce::uint64 position,
+    const ParameterSnapshot& params
+) {
+    // The ceiling only looks ahead while the installed stage reports the
+    // delay as latency. Switching it takes effect with the next stage: until
+    // then the ceiling keeps delaying the signal, or only holds the sample
+    // peaks. Those are all it can hold without oversampling anyway.
+    if (oversampler.hasLookAhead()) {
+        ceiling.process(
+            channels,
+            numSamples,
+            position,
+            params.truePeak,
+            params.truePeakCeiling
+        );
+    } else if (params.truePeak) {
+        auto level = (SampleType)params.truePeakCeiling;
+        for (int ch = 0; ch < numChannels; ch++) {
+            juce::FloatVectorOperations::clip(
+                channels[ch], channels[ch], -level, level, numSamples
+            );
+        }
+    }
+}
+
+template <typename SampleType>
+void NoisatAudioProcessor::crossfadeTransition(
+    juce::dsp::AudioBlock<SampleType>& block, int numSamples
+) {
+    const auto& fromBlock = getBuffers<SampleType>().transition;
+    auto length = (SampleType)transitionLength;
+
+    for (int channel = 0; channel < numChannels; channel++) {
+        auto* out = block.getChannelPointer((size_t)channel);
+        const auto* from = fromBlock.getReadPointer(channel);
+
+        for (int i = 0; i < numSamples; i++) {
+            auto position = transitionPosition + i;
+            SampleType t = position < transitionLength
+                ? (SampleType)(position + 1) / length
+                : (SampleType)1;
+            out[i] = from[i] + (out[i] - from[i]) * t;
+        }
+    }
+
+    transitionPosition =
+        std::min(transitionPosition + numSamples, transitionLength);
 }
 
 //==============================================================================
 bool NoisatAudioProcessor::hasEditor() const {
-    return true; // (change this to false if you choose to not supply an
-                 // editor)
+#if NOISAT_HEADLESS
+    return false;
+#else
+    return true;
+#endif
 }
 
 juce::AudioProcessorEditor* NoisatAudioProcessor::createEditor() {
+#if NOISAT_HEADLESS
+    return nullptr;
+#else
     return new NoisatAudioProcessorEditor(*this);
+#endif
 }
 
 //==============================================================================
 void NoisatAudioProcessor::getStateInformation(juce::MemoryBlock& destData) {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree
-    // classes as intermediaries to make it easy to save and load complex data.
+    getState().writeTo(destData);
 }
 
 void NoisatAudioProcessor::setStateInformation(
     const void* data, int sizeInBytes
 ) {
-    // You should use this method to restore your parameters from this memory
-    // block, whose contents will have been created by the
-    // getStateInformation() call.
+    // Anything missing from the stored state stays as it is.
+    auto state = getState();
+    if (state.readFrom(data, sizeInBytes)) setState(state);
+}
+
+PluginState NoisatAudioProcessor::getState() const {
+    PluginState state;
+
+    for (size_t i = 0; i < PluginState::numValues; i++) {
+        if (auto* parameter = findParameter(PluginState::parameterIds[i])) {
+            state.values[i] = parameter->convertFrom0to1(parameter->getValue());
+        }
+    }
+    for (size_t i = 0; i < state.controlPoints.size(); i++) {
+        state.controlPoints[i] = transferCurve.getControlPoint(i);
+    }
+    state.program = currentProgram;
+    state.seed = seed.load();
+
+    return state;
+}
+
+void NoisatAudioProcessor::setState(const PluginState& state) {
+    stateSequence.fetch_add(1, std::memory_order_acq_rel);
+
+    for (size_t i = 0; i < PluginState::numValues; i++) {
+        if (auto* parameter = findParameter(PluginState::parameterIds[i])) {
+            parameter->setValueNotifyingHost(
+                parameter->convertTo0to1(state.values[i])
+            );
+        }
+    }
+    for (size_t i = 0; i < state.controlPoints.size(); i++) {
+        auto point = state.controlPoints[i];
+        transferCurve.setControlPoint(
+            i,
+            { juce::jlimit(0.0f, 1.0f, point.x),
+              juce::jlimit(0.0f, 1.0f, point.y) }
+        );
+    }
+    currentProgram =
+        juce::jlimit(0, getNumPrograms() - 1, state.program);
+    seed = state.seed;
+
+    // The tables derived from the new settings are built right here, off the
+    // audio thread, rather than on the next frame: the transfer table is
+    // published before the audio thread adopts the new state, and the noise
+    // table requested from its worker.
+    transferCurve.updateNowIfNeeded();
+    noiseTable.requestRenderNowIfNeeded();
+    stateSequence.fetch_add(1, std::memory_order_release);
 }
 
 //==============================================================================
 // This creates new instances of the plugin..
+#if !NOISAT_HEADLESS
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter() {
     return new NoisatAudioProcessor();
 }
+#endif
@@ -1,26 +1,37 @@
 #pragma once
 
+#include "AllocationDetector.h"
+#include "Core/Engine.h"
+#include "Core/Multiband.h"
+#include "Core/TruePeak.h"
+#include "NoiseTable.h"
+#include "Oversampler.h"
+#include "PerformanceMonitor.h"
+#include "PluginState.h"
+#include "SpectrumAnalyzer.h"
+#include "TransferCurve.h"
 #include <JuceHeader.h>
 
-class DoubleIIR : public juce::AudioProcessorParameter::Listener,
-                  public juce::AsyncUpdater {
+using BiquadCoefficients = noisat::core::BiquadCoefficients;
+using SvfCoefficients = noisat::core::SvfCoefficients;
+
+// Parameters of the filters that colour the noise. The filtering itself runs
+// in noisat::core::NoiseFilter, as part of the engine.
+class DoubleIIR {
 public:
     using Param = juce::AudioParameterFloat;
-    DoubleIIR();
-    ~DoubleIIR();
 
-    void parameterValueChanged(int parameterIndex, float newValue) override;
-    void parameterGestureChanged(
-        int parameterIndex, bool gestureIsStarting
-    ) override {};
-    void handleAsyncUpdate() override;
+    DoubleIIR();
 
-    void prepare(juce::dsp::ProcessSpec spec);
-    float processSample(float sample);
+    void prepare(double sampleRate);
+    noisat::core::NoiseFilterSettings getSettings() const;
 
-    void getMagnitude(
-        const double* frequencies, double* magnitudes, size_t numSamples
-    );
+    // Squared magnitude response of both filters at every point of `grid`,
+    // which must have been set up for getSampleRate(). Message thread only.
+    void getPowerResponse(
+        const noisat::core::FrequencyGrid& grid, double* power
+    ) const;
+    double getSampleRate() const { return sampleRate.load(); }
 
     juce::AudioParameterFloat* hpFreq;
     juce::AudioParameterFloat* hpQ;
@@ -28,26 +39,183 @@ public:
     juce::AudioParameterFloat* lpFreq;
     juce::AudioParameterFloat* lpQ;
 
-    juce::dsp::IIR::Filter<float> hpFilter;
-    juce::dsp::IIR::Filter<float> lpFilter;
-
 private:
-    juce::dsp::ProcessSpec spec;
-
-    juce::ReferenceCountedObjectPtr<juce::dsp::IIR::Coefficients<float>>
-        hpCoeffs;
-    juce::ReferenceCountedObjectPtr<juce::dsp::IIR::Coefficients<float>>
-        lpCoeffs;
+    std::atomic<double> sampleRate{ 44100.0 };
 };
 
 class Clipper {
 public:
+    using Shape = noisat::core::ClipShape;
+
     Clipper();
-    float evaluate(float sample);
+    Shape getShape() const;
+    float evaluate(float sample) const;
+
+    // Clips both polarities of `numSamples` samples. `in` and `out` may alias.
+    void process(const float* in, float* out, size_t numSamples) const;
+    template <typename SampleType>
+    static void process(
+        const Shape& shape, const SampleType* in, SampleType* out,
+        size_t numSamples
+    ) {
+        noisat::core::clip(shape, in, out, numSamples);
+    }
 
     juce::AudioParameterFloat* threshold;
     juce::AudioParameterFloat* knee;
     juce::AudioParameterFloat* ratio;
+    juce::AudioParameterBool* custom;
+};
+
+// Parameters of the multiband mode. The processing runs in
+// noisat::core::MultibandClipper.
+class Multiband {
+public:
+    static constexpr int maxBands = noisat::core::maxBands;
+
+    Multiband();
+    noisat::core::MultibandSettings getSettings() const;
+
+    struct Band {
+        juce::AudioParameterFloat* threshold;
+        juce::AudioParameterFloat* knee;
+        juce::AudioParameterFloat* ratio;
+        juce::AudioParameterFloat* noiseThres;
+    };
+
+    juce::AudioParameterInt* numBands;
+    std::array<juce::AudioParameterFloat*, maxBands - 1> crossovers;
+    std::array<Band, maxBands> bands;
+};
+
+// Plain copy of every parameter the audio thread needs, taken once per block:
+// those of the engine plus the ones only the wrapper looks at.
+struct ParameterSnapshot : noisat::core::Parameters {
+    bool noiseTable;
+    bool clipCustom;
+    noisat::core::MultibandSettings multiband;
+    bool truePeak;
+    // Linear gain.
+    float truePeakCeiling;
+    juce::uint64 seed;
+};
+
+// Linear ramps for the parameters that are applied per sample at the
+// oversampled rate. Ramps are only rendered while at least one value is still
+// moving towards its target, otherwise the targets can be used as constants.
+class SmoothedParameters {
+public:
+    // The band settings and crossovers take a ramp per band or crossover.
+    static constexpr int maxBands = noisat::core::maxBands;
+    enum Index {
+        preGain = 0,
+        postGain,
+        dryWet,
+        clipThres,
+        clipKnee,
+        clipRatio,
+        bandClipThres,
+        bandClipKnee = bandClipThres + maxBands,
+        bandClipRatio = bandClipKnee + maxBands,
+        bandNoiseThres = bandClipRatio + maxBands,
+        crossover = bandNoiseThres + maxBands,
+        numSmoothed = crossover + maxBands - 1
+    };
+
+    // Ramps are only allocated for the precision in use.
+    void prepare(
+        double sampleRate, int maxBlockSize, bool doublePrecision,
+        const ParameterSnapshot& initial
+    );
+    void setTargets(const ParameterSnapshot& snapshot);
+    bool isSmoothing() const;
+
+    template <typename SampleType> void renderRamps(int numSamples);
+    template <typename SampleType>
+    const SampleType* getRamp(Index index) const {
+        return getRampBuffer<SampleType>().getReadPointer(index);
+    }
+    template <typename SampleType>
+    noisat::core::Ramps<SampleType> getRamps() const {
+        noisat::core::Ramps<SampleType> result;
+        result.preGain = getRamp<SampleType>(preGain);
+        result.postGain = getRamp<SampleType>(postGain);
+        result.dryWet = getRamp<SampleType>(dryWet);
+        result.clipThres = getRamp<SampleType>(clipThres);
+        result.clipKnee = getRamp<SampleType>(clipKnee);
+        result.clipRatio = getRamp<SampleType>(clipRatio);
+        return result;
+    }
+    template <typename SampleType>
+    noisat::core::BandRamps<SampleType> getBandRamps() const {
+        noisat::core::BandRamps<SampleType> result;
+        for (int band = 0; band < maxBands; band++) {
+            auto b = (size_t)band;
+            auto at = [this, band](int first) {
+                return getRamp<SampleType>((Index)(first + band));
+            };
+            result.clipThres[b] = at(bandClipThres);
+            result.clipKnee[b] = at(bandClipKnee);
+            result.clipRatio[b] = at(bandClipRatio);
+            result.noiseThreshold[b] = at(bandNoiseThres);
+        }
+        for (int split = 0; split < maxBands - 1; split++) {
+            result.crossovers[(size_t)split] =
+                getRamp<SampleType>((Index)(crossover + split));
+        }
+        return result;
+    }
+    float getCurrentValue(Index index) const {
+        return values[index].getCurrentValue();
+    }
+
+private:
+    template <typename SampleType>
+    const juce::AudioBuffer<SampleType>& getRampBuffer() const {
+        return std::get<juce::AudioBuffer<SampleType>>(ramps);
+    }
+
+    std::array<juce::SmoothedValue<float>, numSmoothed> values;
+    std::tuple<juce::AudioBuffer<float>, juce::AudioBuffer<double>> ramps;
+};
+
+// Ring buffer of the most recent input at the host rate.
+template <typename SampleType> class InputHistory {
+public:
+    void prepare(int numChannels, int capacity);
+    void push(const juce::AudioBuffer<SampleType>& buffer, int numSamples);
+
+    // Copies `numSamples` samples of `channel`, starting `age` samples before
+    // the end of the most recently pushed block.
+    void read(
+        int channel, int age, SampleType* destination, int numSamples
+    ) const;
+
+private:
+    juce::AudioBuffer<SampleType> samples;
+    int writePosition = 0;
+};
+
+// Working buffers of the processor for one sample type. Only those of the
+// precision the host asked for are allocated.
+template <typename SampleType> struct ProcessingBuffers {
+    void prepare(
+        int numChannels, int maxBlockSize, int maxOversampledBlockSize,
+        int historyLength, int warmUpLength
+    );
+    void release();
+
+    juce::AudioBuffer<SampleType> noise;
+    // Channel pointers of the oversampled block, as the engine takes them.
+    std::vector<SampleType*> channels;
+
+    // The oversampled block as processed with the settings being faded out
+    // after a state change.
+    juce::AudioBuffer<SampleType> transition;
+
+    InputHistory<SampleType> history;
+    juce::AudioBuffer<SampleType> bypass;
+    juce::AudioBuffer<SampleType> warmUp;
 };
 
 class NoisatAudioProcessor : public juce::AudioProcessor {
@@ -63,6 +231,8 @@ public:
 #endif
 
     void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock(juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
@@ -83,19 +253,162 @@ public:
     void getStateInformation(juce::MemoryBlock& destData) override;
     void setStateInformation(const void* data, int sizeInBytes) override;
 
+    // Message thread only. The audio thread switches to a new state as a
+    // whole, once every parameter has been set, and crossfades to it.
+    PluginState getState() const;
+    void setState(const PluginState& state);
+
+    // Any thread. The noise is drawn from the seed, which starts out random
+    // and is saved with the state.
+    juce::uint64 getSeed() const { return seed.load(); }
+    void setSeed(juce::uint64 newSeed) { seed = newSeed; }
+
+    // Audio thread only, between blocks. The noise follows the position in
+    // host samples, counted from prepareToPlay(). An offline render split
+    // into pieces sets it to where each piece starts, and then renders the
+    // same noise as a render in one piece.
+    void setPosition(juce::int64 hostSample) { position = hostSample; }
+
+    // How long a processor that starts mid-stream, like one rendering a
+    // piece, has to run before its state matches one that ran from the
+    // start, for the current settings. By then, whatever differences there
+    // were have decayed to `settlingTolerance` of where they started.
+    double getSettlingSeconds() const;
+    static constexpr double settlingTolerance = 1.0e-6;
+
     juce::AudioParameterFloat* noiseThres;
+    juce::AudioParameterFloat* noiseCorrelation;
 
     juce::AudioParameterFloat* preGain;
     juce::AudioParameterFloat* postGain;
     juce::AudioParameterFloat* dryWet;
 
+    // Holds the true peak of the output below the ceiling, in dBTP.
+    juce::AudioParameterBool* truePeak;
+    juce::AudioParameterFloat* truePeakCeiling;
+
     DoubleIIR noiseEq;
+    NoiseTable noiseTable{ noiseEq };
     Clipper clipper;
+    Multiband multiband;
+    TransferCurve transferCurve{ clipper };
+    Oversampler oversampler{ *this, noisat::core::TruePeakCeiling::lookAhead };
+    PerformanceMonitor performance;
+    SpectrumAnalyzer analyzer;
 
 private:
-    juce::Random noiseGen;
-    std::unique_ptr<juce::dsp::Oversampling<float>> oversampling;
-    const size_t oversamplingFactor = 1;
+    ParameterSnapshot getParameterSnapshot() const;
+    ParameterSnapshot adoptParameterSnapshot();
+    juce::RangedAudioParameter* findParameter(const juce::String& id) const;
+    void prepareOversampledRate();
+
+    // The float and double entry points share everything below.
+    template <typename SampleType>
+    void process(juce::AudioBuffer<SampleType>& buffer);
+
+    template <typename SampleType>
+    SampleType getPeak(const juce::AudioBuffer<SampleType>& buffer) const;
+    bool canBypass(float peak, const ParameterSnapshot& params) const;
+    template <typename SampleType>
+    void warmUpOversampling(
+        int numSamples, juce::uint64 blockPosition,
+        const ParameterSnapshot& params
+    );
+    template <typename SampleType>
+    void crossfadeWithBypass(
+        juce::AudioBuffer<SampleType>& buffer, int numSamples, bool toBypass
+    );
+
+    template <typename SampleType, bool IsSmoothing>
+    void processBypassed(int numSamples, const ParameterSnapshot& params);
+
+    template <typename SampleType>
+    void processQuiet(
+        juce::dsp::AudioBlock<SampleType>& block,
+        const ParameterSnapshot& params, bool isSmoothing,
+        juce::uint64 noisePosition
+    );
+    template <typename SampleType>
+    void processOversampled(
+        juce::dsp::AudioBlock<SampleType>& block,
+        const ParameterSnapshot& params, bool isSmoothing,
+        juce::uint64 noisePosition
+    );
+    template <typename SampleType>
+    void crossfadeTransition(
+        juce::dsp::AudioBlock<SampleType>& block, int numSamples
+    );
+    template <typename SampleType>
+    void applyCeiling(
+        SampleType* const* channels, int numSamples, juce::uint64 position,
+        const ParameterSnapshot& params
+    );
+
+    template <typename SampleType> ProcessingBuffers<SampleType>& getBuffers() {
+        if constexpr (std::is_same_v<SampleType, float>) {
+            return floatBuffers;
+        } else {
+            return doubleBuffers;
+        }
+    }
+
+    SmoothedParameters smoothed;
+    noisat::core::Engine engine;
+
+    // The bands keep filter state, so the settings being faded out after a
+    // state change run on a copy, taken when the fade starts.
+    noisat::core::MultibandClipper bands;
+    noisat::core::MultibandClipper transitionBands;
+    noisat::core::TruePeakCeiling ceiling;
+
+    ProcessingBuffers<float> floatBuffers;
+    ProcessingBuffers<double> doubleBuffers;
+    int numChannels = 0;
+
+    // Everything running at the oversampled rate is sized for the highest
+    // factor, so that switching factors never allocates.
+    int maxOversampledBlockSize = 0;
+
+    // Blocks that stay below the clipping threshold skip the oversampled
+    // path. The input history provides the latency-matched dry signal for
+    // them, and is replayed through the oversampling filters on the way back.
+    // A plain delay only matches the linear phase filters, so with the IIR
+    // ones such blocks still run through the filters, and only skip what
+    // happens in between.
+    static constexpr int warmUpLength = 256;
+    static constexpr int bypassFadeLength = 64;
+    bool bypassed = false;
+
+    // Digital silence skips the IIR filters too, once they have rung out
+    // and been cleared: after `silenceTailLength` host samples past the
+    // latency, as soon as a block comes out exactly zero.
+    static constexpr int silenceTailLength = 2048;
+    int silentLength = 0;
+    bool filtersCleared = false;
+
+    // setState() makes the sequence odd while it sets the parameters and
+    // even again once it is done. Until then, the audio thread keeps using
+    // the snapshot it adopted last. A new state is faded in from the old
+    // one over `transitionSeconds`, with both rendered in parallel. The fade
+    // only runs on the oversampled path: the bypass path is only taken where
+    // the two states sound the same apart from their gains, which are ramped.
+    static constexpr double transitionSeconds = 0.01;
+    std::atomic<juce::uint32> stateSequence{ 0 };
+    juce::uint32 adoptedSequence = 0;
+    ParameterSnapshot adoptedParams;
+    ParameterSnapshot transitionFrom;
+    int transitionLength = 0;
+    int transitionPosition = 0;
+
+    // setState() publishes the new state's custom curve table before the
+    // audio thread adopts it, so the old state's is copied while it is still
+    // the one read last, and kept for the fade. Null without a custom curve.
+    TransferTable transitionTable;
+    const TransferTable* transitionFromTable = nullptr;
+
+    int currentProgram = 0;
+    std::atomic<juce::uint64> seed{ 0 };
+    juce::int64 position = 0;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NoisatAudioProcessor)
 };
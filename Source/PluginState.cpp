@@ -0,0 +1,188 @@
+#include "PluginState.h"
+
+const std::array<const char*, PluginState::numValues>
+    PluginState::parameterIds = {
+        "noiseHpQ",
+        "noiseHpFreq",
+        "noiseLpQ",
+        "noiseLpFreq",
+        "clipThres",
+        "clipKnee",
+        "clipRatio",
+        "noiseThres",
+        "preGain",
+        "postGain",
+        "dryWet",
+        "clipCustom",
+        "noiseCorrelation",
+        "noiseTable",
+        "oversampling",
+        "oversamplingFilter",
+        "bands",
+        "crossover1",
+        "crossover2",
+        "crossover3",
+        "band1Thres",
+        "band1Knee",
+        "band1Ratio",
+        "band1NoiseThres",
+        "band2Thres",
+        "band2Knee",
+        "band2Ratio",
+        "band2NoiseThres",
+        "band3Thres",
+        "band3Knee",
+        "band3Ratio",
+        "band3NoiseThres",
+        "band4Thres",
+        "band4Knee",
+        "band4Ratio",
+        "band4NoiseThres",
+        "truePeak",
+        "truePeakCeiling"
+    };
+
+int PluginState::indexOf(const juce::String& parameterId) {
+    for (size_t i = 0; i < numValues; i++) {
+        if (parameterId == parameterIds[i]) return (int)i;
+    }
+    return -1;
+}
+
+void PluginState::writeTo(juce::MemoryBlock& destination) const {
+    juce::MemoryOutputStream stream(destination, false);
+
+    stream.writeInt((int)magic);
+    stream.writeShort((short)version);
+
+    stream.writeByte((char)values.size());
+    for (auto value : values) {
+        stream.writeFloat(value);
+    }
+
+    stream.writeByte((char)controlPoints.size());
+    for (auto point : controlPoints) {
+        stream.writeFloat(point.x);
+        stream.writeFloat(point.y);
+    }
+
+    stream.writeByte((char)program);
+    stream.writeInt64((juce::int64)seed);
+}
+
+bool PluginState::readFrom(const void* data, int sizeInBytes) {
+    juce::MemoryInputStream stream(data, (size_t)sizeInBytes, false);
+    auto hasBytes = [&stream](juce::int64 numBytes) {
+        return stream.getNumBytesRemaining() >= numBytes;
+    };
+
+    if (!hasBytes(6) || (juce::uint32)stream.readInt() != magic) return false;
+    stream.readShort();
+
+    // Every section is optional from here on, and may be longer than this
+    // version knows about. A truncated section makes the whole state invalid.
+    auto result = *this;
+
+    if (hasBytes(1)) {
+        auto count = (int)(juce::uint8)stream.readByte();
+        if (!hasBytes(count * 4)) return false;
+
+        for (int i = 0; i < count; i++) {
+            auto value = stream.readFloat();
+            if ((size_t)i < numValues) result.values[(size_t)i] = value;
+        }
+    }
+
+    if (hasBytes(1)) {
+        auto count = (int)(juce::uint8)stream.readByte();
+        if (!hasBytes(count * 8)) return false;
+
+        for (int i = 0; i < count; i++) {
+            auto x = stream.readFloat();
+            auto y = stream.readFloat();
+            if ((size_t)i < result.controlPoints.size()) {
+                result.controlPoints[(size_t)i] = { x, y };
+            }
+        }
+    }
+
+    if (hasBytes(1)) result.program = (int)(juce::uint8)stream.readByte();
+    if (hasBytes(8)) result.seed = (juce::uint64)stream.readInt64();
+
+    *this = result;
+    return true;
+}
+
+const std::vector<Preset>& Preset::getFactoryPresets() {
+    static const std::vector<Preset> presets{
+        { "Init", {} },
+        { "Soft Saturation",
+          { { "preGain", 1.5f },
+            { "clipThres", 0.5f },
+            { "clipKnee", 0.6f },
+            { "clipRatio", 4.0f },
+            { "postGain", 0.9f },
+            { "dryWet", 0.0f } } },
+        { "Hard Clipper",
+          { { "preGain", 2.0f },
+            { "clipThres", 0.8f },
+            { "clipKnee", 0.0f },
+            { "clipRatio", 40.0f },
+            { "dryWet", 0.0f } } },
+        { "Crackle",
+          { { "preGain", 2.5f },
+            { "clipThres", 0.3f },
+            { "clipKnee", 0.2f },
+            { "clipRatio", 20.0f },
+            { "noiseThres", 0.05f },
+            { "noiseHpFreq", 2000.0f },
+            { "noiseLpFreq", 12000.0f },
+            { "postGain", 0.8f },
+            { "dryWet", 0.0f } } },
+        { "Dusty Parallel",
+          { { "preGain", 3.0f },
+            { "clipThres", 0.2f },
+            { "clipKnee", 0.5f },
+            { "clipRatio", 10.0f },
+            { "noiseThres", 0.1f },
+            { "noiseLpFreq", 4000.0f },
+            { "noiseLpQ", 0.7f },
+            { "postGain", 0.7f },
+            { "dryWet", 0.5f } } },
+        { "Mono Fuzz",
+          { { "preGain", 4.0f },
+            { "clipThres", 0.15f },
+            { "clipKnee", 0.1f },
+            { "clipRatio", 40.0f },
+            { "noiseThres", 0.02f },
+            { "noiseCorrelation", 1.0f },
+            { "noiseHpFreq", 200.0f },
+            { "noiseHpQ", 0.7f },
+            { "postGain", 0.5f },
+            { "dryWet", 0.0f } } },
+        { "Multiband Glue",
+          { { "preGain", 2.0f },
+            { "bands", 3.0f },
+            { "crossover1", 200.0f },
+            { "crossover2", 3000.0f },
+            { "band1Thres", 0.6f },
+            { "band1Knee", 0.8f },
+            { "band1Ratio", 3.0f },
+            { "band2Thres", 0.4f },
+            { "band2Knee", 0.5f },
+            { "band2Ratio", 6.0f },
+            { "band3Thres", 0.25f },
+            { "band3Knee", 0.3f },
+            { "band3Ratio", 12.0f },
+            { "band3NoiseThres", 0.05f },
+            { "postGain", 0.8f },
+            { "dryWet", 0.0f } } },
+    };
+    return presets;
+}
+
+bool Preset::isSoundParameter(const juce::String& parameterId) {
+    return parameterId != "noiseTable" && parameterId != "oversampling"
+        && parameterId != "oversamplingFilter" && parameterId != "truePeak"
+        && parameterId != "truePeakCeiling";
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "TransferCurve.h"
+#include <JuceHeader.h>
+
+// Everything the processor saves with a session: the plain value of every
+// parameter, the control points of the custom curve, the selected preset and
+// the noise seed.
+// Stored in a compact binary format, little endian:
+//
+//   uint32   magic, "NSAT"
+//   uint16   version
+//   uint8    number of parameter values, followed by as many float32
+//   uint8    number of control points, followed by as many float32 (x, y)
+//   uint8    selected preset
+//   uint64   noise seed
+//
+// Parameter values are stored in the order of `parameterIds`, which later
+// versions may only append to. Values missing from an older state keep
+// whatever they were set to before reading, and values appended by a newer
+// version are skipped.
+struct PluginState {
+    static constexpr juce::uint32 magic = 0x5441534e;
+    static constexpr int version = 4;
+    static constexpr size_t numValues = 38;
+    static const std::array<const char*, numValues> parameterIds;
+
+    // Index into `values`, or -1 for an unknown parameter.
+    static int indexOf(const juce::String& parameterId);
+
+    std::array<float, numValues> values{};
+    std::array<juce::Point<float>, TransferCurve::numControlPoints>
+        controlPoints;
+    int program = 0;
+
+    // The noise is a function of the seed and the position in the session,
+    // so that a restored session renders the same noise again.
+    juce::uint64 seed = 0;
+
+    void writeTo(juce::MemoryBlock& destination) const;
+
+    // Returns false, leaving the state untouched, if `data` is not a complete
+    // state.
+    bool readFrom(const void* data, int sizeInBytes);
+};
+
+// Factory presets, exposed to the host as programs. A preset sets every
+// parameter that shapes the sound, starting from its default, and leaves the
+// oversampling and noise table settings alone: those trade quality for CPU
+// and latency rather than being part of a sound. The true peak ceiling is
+// left alone too, as it depends on where the output is delivered.
+struct Preset {
+    const char* name;
+    std::vector<std::pair<const char*, float>> values;
+
+    static const std::vector<Preset>& getFactoryPresets();
+    static bool isSoundParameter(const juce::String& parameterId);
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include <memory>
+
+// Process-wide cache of immutable data derived from a key, like tables that
+// only depend on the sample rate and a few parameters. Instances with the
+// same settings share one copy instead of each building their own. Use it
+// through a juce::SharedResourcePointer, which makes one cache per type for
+// the whole process.
+//
+// The cache only holds weak references, so an entry is freed as soon as the
+// last instance lets go of it. get() may build and free memory, so neither it
+// nor releasing the last reference to an entry belongs on the audio thread.
+template <typename Key, typename Value> class SharedCache {
+public:
+    using Pointer = std::shared_ptr<const Value>;
+
+    // Returns the entry for `key`, calling `build(Value&)` to fill in a new
+    // one if nobody holds it. Builds run outside the lock, so that building
+    // different keys does not serialise. Threads racing to build the same key
+    // all build it, but end up sharing the entry of whoever finished first.
+    template <typename Build> Pointer get(const Key& key, Build&& build) {
+        {
+            const juce::ScopedLock sl(lock);
+            if (auto existing = find(key)) return existing;
+        }
+
+        auto entry = std::make_shared<Value>();
+        build(*entry);
+
+        const juce::ScopedLock sl(lock);
+        if (auto existing = find(key)) return existing;
+
+        removeExpired();
+        entries[key] = entry;
+        return entry;
+    }
+
+private:
+    Pointer find(const Key& key) const {
+        auto it = entries.find(key);
+        return it != entries.end() ? it->second.lock() : nullptr;
+    }
+
+    void removeExpired() {
+        for (auto it = entries.begin(); it != entries.end();) {
+            it = it->second.expired() ? entries.erase(it) : std::next(it);
+        }
+    }
+
+    juce::CriticalSection lock;
+    std::map<Key, std::weak_ptr<const Value>> entries;
+};
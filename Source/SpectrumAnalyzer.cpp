@@ -0,0 +1,274 @@
+#include "SpectrumAnalyzer.h"
+
+namespace {
+// Weight of each new frame in the running average.
+constexpr float averaging = 0.3f;
+// Floor for silent taps and for frequencies above a tap's Nyquist.
+constexpr float floorDecibels = -120.0f;
+} // namespace
+
+SpectrumAnalyzer::SpectrumAnalyzer() : juce::Thread("Spectrum analyzer") {}
+
+SpectrumAnalyzer::~SpectrumAnalyzer() { stopThread(1000); }
+
+void SpectrumAnalyzer::prepare(
+    double rate, int numChannels, int maxBlockSize
+) {
+    const juce::ScopedLock lock(workerLock);
+
+    // Room for several worker intervals at the highest rate of each tap.
+    auto hostCapacity = std::max(
+        maxBlockSize * 4, (int)(rate * refreshInterval / 1000.0) * 4
+    );
+
+    for (int index = 0; index < numTaps; index++) {
+        auto& tap = taps[(size_t)index];
+        auto factor = index == noise ? 1 << maxFactorIndex : 1;
+
+        tap.samples.setSize(numChannels, hostCapacity * factor);
+        tap.fifo.setTotalSize(hostCapacity * factor);
+        tap.factorIndex = -1;
+    }
+
+    incoming.resize((size_t)(hostCapacity << maxFactorIndex));
+    fftData.assign((size_t)2 << (fftOrder + maxFactorIndex), 0.0f);
+
+    // Each point averages the bins between the geometric midpoints to its
+    // neighbours, or interpolates where no bin falls in between.
+    auto ratio = std::pow(maxFrequency / minFrequency, 1.0 / (numPoints - 1));
+    auto edgeRatio = std::sqrt(ratio);
+
+    for (int factorIndex = 0; factorIndex <= maxFactorIndex; factorIndex++) {
+        auto fftSize = 1 << (fftOrder + factorIndex);
+        auto tapRate = rate * (1 << factorIndex);
+        auto binWidth = tapRate / fftSize;
+        auto lastBin = fftSize / 2;
+
+        for (int point = 0; point < numPoints; point++) {
+            auto frequency = minFrequency * std::pow(ratio, point);
+            auto& bins = binnings[(size_t)factorIndex][(size_t)point];
+
+            bins.belowNyquist = frequency < tapRate * 0.5;
+            bins.first = (int)std::ceil(frequency / edgeRatio / binWidth);
+            bins.last = std::min(
+                (int)std::floor(frequency * edgeRatio / binWidth), lastBin
+            );
+            bins.bin = (float)(frequency / binWidth);
+        }
+    }
+}
+
+void SpectrumAnalyzer::setEnabled(bool shouldBeEnabled) {
+    if (shouldBeEnabled == enabled.load()) return;
+
+    enabled = shouldBeEnabled;
+    if (shouldBeEnabled) {
+        startThread(juce::Thread::Priority::low);
+    } else {
+        stopThread(1000);
+    }
+}
+
+template <typename Write>
+void SpectrumAnalyzer::write(Tap tap, int numSamples, Write&& fn) {
+    auto& state = taps[(size_t)tap];
+    auto scope = state.fifo.write(numSamples);
+
+    for (int ch = 0; ch < state.samples.getNumChannels(); ch++) {
+        auto* samples = state.samples.getWritePointer(ch);
+
+        if (scope.blockSize1 > 0) {
+            fn(ch, samples + scope.startIndex1, 0, scope.blockSize1);
+        }
+        if (scope.blockSize2 > 0) {
+            auto offset = scope.blockSize1;
+            fn(ch, samples + scope.startIndex2, offset, scope.blockSize2);
+        }
+    }
+}
+
+template <typename SampleType>
+void SpectrumAnalyzer::push(
+    Tap tap, const juce::AudioBuffer<SampleType>& samples, int numSamples,
+    int rateFactor
+) {
+    taps[(size_t)tap].rateFactor.store(rateFactor, std::memory_order_relaxed);
+
+    auto numChannels = samples.getNumChannels();
+    write(tap, numSamples, [&](int ch, float* dest, int offset, int length) {
+        if (ch >= numChannels) {
+            juce::FloatVectorOperations::clear(dest, length);
+            return;
+        }
+
+        const auto* source = samples.getReadPointer(ch, offset);
+        if constexpr (std::is_same_v<SampleType, float>) {
+            juce::FloatVectorOperations::copy(dest, source, length);
+        } else {
+            for (int i = 0; i < length; i++) {
+                dest[i] = (float)source[i];
+            }
+        }
+    });
+}
+
+template void SpectrumAnalyzer::push<float>(
+    Tap, const juce::AudioBuffer<float>&, int, int
+);
+template void SpectrumAnalyzer::push<double>(
+    Tap, const juce::AudioBuffer<double>&, int, int
+);
+
+void SpectrumAnalyzer::pushSilence(Tap tap, int numSamples, int rateFactor) {
+    taps[(size_t)tap].rateFactor.store(rateFactor, std::memory_order_relaxed);
+
+    write(tap, numSamples, [](int, float* dest, int, int length) {
+        juce::FloatVectorOperations::clear(dest, length);
+    });
+}
+
+void SpectrumAnalyzer::discardPending() {
+    for (auto& tap : taps) {
+        tap.fifo.read(tap.fifo.getNumReady());
+    }
+}
+
+void SpectrumAnalyzer::run() {
+    // Whatever was left in the FIFOs when the worker last stopped is stale.
+    {
+        const juce::ScopedLock lock(workerLock);
+        discardPending();
+    }
+
+    while (!threadShouldExit()) {
+        {
+            const juce::ScopedLock lock(workerLock);
+
+            bool changed = false;
+            for (auto& tap : taps) {
+                changed |= analyse(tap);
+            }
+
+            if (changed) {
+                auto& spectrum = spectra.getWriteBuffer();
+                for (size_t index = 0; index < taps.size(); index++) {
+                    for (size_t point = 0; point < numPoints; point++) {
+                        spectrum.levels[index][point] =
+                            juce::Decibels::gainToDecibels(
+                                std::sqrt(taps[index].power[point]),
+                                floorDecibels
+                            );
+                    }
+                }
+                spectrum.frame = ++frame;
+                spectra.publish();
+            }
+        }
+
+        wait(refreshInterval);
+    }
+}
+
+bool SpectrumAnalyzer::analyse(TapState& tap) {
+    auto numReady = tap.fifo.getNumReady();
+    if (numReady == 0 || tap.samples.getNumChannels() == 0) return false;
+
+    auto factor = tap.rateFactor.load(std::memory_order_relaxed);
+    auto factorIndex = juce::jlimit(
+        0, maxFactorIndex, juce::roundToInt(std::log2((double)factor))
+    );
+    auto fftSize = 1 << (fftOrder + factorIndex);
+
+    // A new rate, or the first frame after prepare(): start from silence.
+    if (tap.factorIndex != factorIndex) {
+        tap.factorIndex = factorIndex;
+        tap.history.assign((size_t)fftSize, 0.0f);
+        tap.power.fill(0.0f);
+    }
+
+    // Mix the new samples down to mono.
+    {
+        auto numChannels = tap.samples.getNumChannels();
+        auto gain = 1.0f / (float)numChannels;
+        auto scope = tap.fifo.read(numReady);
+
+        auto mixDown = [&](int start, int length, int offset) {
+            auto* dest = incoming.data() + offset;
+            juce::FloatVectorOperations::copyWithMultiply(
+                dest, tap.samples.getReadPointer(0, start), gain, length
+            );
+            for (int ch = 1; ch < numChannels; ch++) {
+                juce::FloatVectorOperations::addWithMultiply(
+                    dest, tap.samples.getReadPointer(ch, start), gain, length
+                );
+            }
+        };
+        mixDown(scope.startIndex1, scope.blockSize1, 0);
+        mixDown(scope.startIndex2, scope.blockSize2, scope.blockSize1);
+    }
+
+    // Slide the history along by the new samples.
+    auto& history = tap.history;
+    auto numNew = std::min(numReady, fftSize);
+    std::move(history.begin() + numNew, history.end(), history.begin());
+    std::copy(
+        incoming.begin() + (numReady - numNew),
+        incoming.begin() + numReady,
+        history.end() - numNew
+    );
+
+    auto& fft = ffts[(size_t)factorIndex];
+    auto& window = windows[(size_t)factorIndex];
+    if (fft == nullptr) {
+        fft = std::make_unique<juce::dsp::FFT>(fftOrder + factorIndex);
+        window.resize((size_t)fftSize);
+        juce::dsp::WindowingFunction<float>::fillWindowingTables(
+            window.data(),
+            (size_t)fftSize,
+            juce::dsp::WindowingFunction<float>::hann,
+            false
+        );
+    }
+
+    juce::FloatVectorOperations::multiply(
+        fftData.data(), history.data(), window.data(), fftSize
+    );
+    juce::FloatVectorOperations::clear(fftData.data() + fftSize, fftSize);
+    fft->performFrequencyOnlyForwardTransform(fftData.data());
+
+    // A full scale sine peaks at a quarter of the length with a Hann window.
+    auto scale = 4.0f / (float)fftSize;
+    auto lastBin = fftSize / 2;
+
+    auto powerAt = [&](float bin) {
+        auto clamped = juce::jlimit(0.0f, (float)lastBin, bin);
+        auto lower = (int)clamped;
+        auto upper = std::min(lower + 1, lastBin);
+        auto t = clamped - (float)lower;
+        auto magnitude = fftData[(size_t)lower]
+            + (fftData[(size_t)upper] - fftData[(size_t)lower]) * t;
+        return magnitude * magnitude * scale * scale;
+    };
+
+    const auto& binning = binnings[(size_t)factorIndex];
+    for (size_t point = 0; point < numPoints; point++) {
+        const auto& bins = binning[point];
+        float value = 0.0f;
+
+        if (bins.belowNyquist) {
+            if (bins.first <= bins.last) {
+                for (int bin = bins.first; bin <= bins.last; bin++) {
+                    value += powerAt((float)bin);
+                }
+                value /= (float)(bins.last - bins.first + 1);
+            } else {
+                value = powerAt(bins.bin);
+            }
+        }
+
+        auto& power = tap.power[point];
+        power += (value - power) * averaging;
+    }
+
+    return true;
+}
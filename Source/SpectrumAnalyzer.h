@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Oversampler.h"
+#include "TripleBuffer.h"
+#include <JuceHeader.h>
+
+// Spectra of the input, the injected noise and the output, for drawing over
+// the noise filter curve. The audio thread only copies samples into one
+// wait-free FIFO per tap, and only while the analyzer is enabled. Everything
+// else (mixing down to mono, windowing, the FFT, averaging and binning to
+// log-spaced frequencies) happens on a worker thread that only runs while
+// enabled, too. Finished spectra are handed to the editor through a
+// TripleBuffer.
+//
+// The noise tap runs at the oversampled rate. Its FFT is longer by the
+// oversampling factor, so that every tap has the same frequency resolution.
+class SpectrumAnalyzer : private juce::Thread {
+public:
+    enum Tap { input = 0, noise, output, numTaps };
+
+    // Log-spaced points between the limits of the noise filter frequencies.
+    static constexpr int numPoints = 256;
+    static constexpr float minFrequency = 4.0f;
+    static constexpr float maxFrequency = 22000.0f;
+
+    // Levels in decibels relative to a full scale sine.
+    struct Spectrum {
+        std::array<std::array<float, numPoints>, numTaps> levels;
+        juce::int64 frame = 0;
+    };
+
+    SpectrumAnalyzer();
+    ~SpectrumAnalyzer() override;
+
+    // Must not run concurrently with the audio thread.
+    void prepare(double sampleRate, int numChannels, int maxBlockSize);
+
+    // Message thread only.
+    void setEnabled(bool shouldBeEnabled);
+    bool isEnabled() const { return enabled.load(); }
+
+    // Audio thread only. `rateFactor` is the ratio of the rate `samples` run
+    // at to the host rate. Samples that do not fit into the FIFO are dropped.
+    template <typename SampleType>
+    void push(
+        Tap tap, const juce::AudioBuffer<SampleType>& samples, int numSamples,
+        int rateFactor
+    );
+    void pushSilence(Tap tap, int numSamples, int rateFactor);
+
+    // Reader side, a single thread only. Switches to the most recently
+    // finished spectrum and returns true if there was a new one.
+    bool update() { return spectra.update(); }
+    const Spectrum& getSpectrum() const { return spectra.getReadBuffer(); }
+
+private:
+    static constexpr int fftOrder = 12;
+    static constexpr int maxFactorIndex = Oversampler::maxFactorIndex;
+    static constexpr int refreshInterval = 33;
+
+    struct TapState {
+        // Audio thread to worker.
+        juce::AbstractFifo fifo{ 1 };
+        juce::AudioBuffer<float> samples;
+        std::atomic<int> rateFactor{ 1 };
+
+        // Worker only.
+        int factorIndex = 0;
+        std::vector<float> history;
+        std::array<float, numPoints> power{};
+    };
+
+    // The bins averaged into a point, or the fractional bin interpolated at
+    // where none falls in between. Points above a tap's Nyquist stay silent.
+    struct PointBins {
+        int first = 0;
+        int last = -1;
+        float bin = 0.0f;
+        bool belowNyquist = false;
+    };
+    using Binning = std::array<PointBins, numPoints>;
+
+    template <typename Write> void write(Tap tap, int numSamples, Write&& fn);
+
+    void run() override;
+    bool analyse(TapState& tap);
+    void discardPending();
+
+    std::atomic<bool> enabled{ false };
+
+    std::array<TapState, numTaps> taps;
+
+    // Held by the worker while it analyses, and by prepare() while it
+    // resizes what the worker reads. `fftData` is sized for the longest FFT.
+    juce::CriticalSection workerLock;
+    std::vector<float> incoming;
+    std::vector<float> fftData;
+
+    // Per oversampling factor. The FFTs and windows are built on first use,
+    // the binning by prepare(), as it depends on the sample rate.
+    std::array<std::unique_ptr<juce::dsp::FFT>, maxFactorIndex + 1> ffts;
+    std::array<std::vector<float>, maxFactorIndex + 1> windows;
+    std::array<Binning, maxFactorIndex + 1> binnings;
+    juce::int64 frame = 0;
+
+    TripleBuffer<Spectrum> spectra;
+};
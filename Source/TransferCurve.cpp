@@ -0,0 +1,163 @@
+#include "TransferCurve.h"
+
+#include "PluginProcessor.h"
+
+namespace {
+// Not a custom curve, for a reader that runs before the first table has been
+// published or while the built-in curve is in use.
+const TransferTable emptyTable{};
+} // namespace
+
+TransferCurve::TransferCurve(Clipper& c) : clipper(c) {
+    controlPoints = { juce::Point<float>{ 0.25f, 0.25f },
+                      juce::Point<float>{ 0.5f, 0.5f },
+                      juce::Point<float>{ 0.75f, 0.7f },
+                      juce::Point<float>{ 1.0f, 0.8f } };
+    updateSpline();
+
+    clipper.custom->addListener(this);
+
+    rebuild();
+}
+
+TransferCurve::~TransferCurve() {
+    clipper.custom->removeListener(this);
+}
+
+void TransferCurve::parameterValueChanged(int parameterIndex, float newValue) {
+    tableUpdate.trigger();
+}
+
+juce::Point<float> TransferCurve::getControlPoint(size_t index) const {
+    return controlPoints[index];
+}
+
+void TransferCurve::setControlPoint(size_t index, juce::Point<float> point) {
+    jassert(point.x >= 0.0f && point.x <= 1.0f);
+    jassert(point.y >= 0.0f && point.y <= 1.0f);
+
+    controlPoints[index] = point;
+    updateSpline();
+    tableUpdate.trigger();
+}
+
+void TransferCurve::evaluate(
+    const float* in, float* out, size_t numSamples
+) const {
+    if (!clipper.custom->get()) {
+        clipper.process(in, out, numSamples);
+        return;
+    }
+
+    for (size_t i = 0; i < numSamples; i++) {
+        out[i] = std::copysign(evaluateCustom(std::abs(in[i])), in[i]);
+    }
+}
+
+const TransferTable& TransferCurve::getTable() {
+    tables.update();
+    return getLastTable();
+}
+
+const TransferTable& TransferCurve::getLastTable() const {
+    const auto& table = tables.getReadBuffer();
+    return table != nullptr ? *table : emptyTable;
+}
+
+void TransferCurve::rebuild() {
+    if (!clipper.custom->get()) {
+        tables.getWriteBuffer() = nullptr;
+        tables.publish();
+        return;
+    }
+
+    CustomKey key;
+    for (size_t i = 0; i < numControlPoints; i++) {
+        key[i * 2] = controlPoints[i].x;
+        key[i * 2 + 1] = controlPoints[i].y;
+    }
+    tables.getWriteBuffer() = customTables->get(
+        key, [this](TransferTable& table) { buildCustom(table); }
+    );
+    tables.publish();
+}
+
+void TransferCurve::buildCustom(TransferTable& table) const {
+    table.custom = true;
+
+    table.start = 0.0f;
+    table.indexScale = (float)TransferTable::size;
+    table.outScale = 1.0f;
+    table.offset = 0.0f;
+    table.tailSlope = 0.0f;
+
+    for (int i = 0; i <= TransferTable::size; i++) {
+        table.values[(size_t)i] =
+            evaluateCustom((float)i / (float)TransferTable::size);
+    }
+}
+
+void TransferCurve::updateSpline() {
+    knots[0] = { 0.0f, 0.0f };
+    std::copy(controlPoints.begin(), controlPoints.end(), knots.begin() + 1);
+    std::sort(knots.begin() + 1, knots.end(), [](auto a, auto b) {
+        return a.x < b.x;
+    });
+
+    constexpr size_t numKnots = numControlPoints + 1;
+    std::array<float, numKnots - 1> secants;
+
+    for (size_t k = 0; k + 1 < numKnots; k++) {
+        float dx = knots[k + 1].x - knots[k].x;
+        secants[k] = dx > 0.0f ? (knots[k + 1].y - knots[k].y) / dx : 0.0f;
+    }
+
+    tangents[0] = secants[0];
+    tangents[numKnots - 1] = secants[numKnots - 2];
+    for (size_t k = 1; k + 1 < numKnots; k++) {
+        tangents[k] = secants[k - 1] * secants[k] <= 0.0f
+            ? 0.0f
+            : (secants[k - 1] + secants[k]) * 0.5f;
+    }
+
+    // Fritsch-Carlson: limit the tangents so that the spline never
+    // overshoots between two knots.
+    for (size_t k = 0; k + 1 < numKnots; k++) {
+        if (secants[k] == 0.0f) {
+            tangents[k] = 0.0f;
+            tangents[k + 1] = 0.0f;
+            continue;
+        }
+
+        float a = tangents[k] / secants[k];
+        float b = tangents[k + 1] / secants[k];
+        float lengthSquared = a * a + b * b;
+
+        if (lengthSquared > 9.0f) {
+            float tau = 3.0f / std::sqrt(lengthSquared);
+            tangents[k] = tau * a * secants[k];
+            tangents[k + 1] = tau * b * secants[k];
+        }
+    }
+}
+
+float TransferCurve::evaluateCustom(float x) const {
+    if (x >= knots.back().x) return knots.back().y;
+
+    size_t k = 0;
+    while (x > knots[k + 1].x) {
+        k++;
+    }
+
+    float dx = knots[k + 1].x - knots[k].x;
+    if (dx <= 0.0f) return knots[k + 1].y;
+
+    float t = (x - knots[k].x) / dx;
+    float t2 = t * t;
+    float t3 = t2 * t;
+
+    return (2.0f * t3 - 3.0f * t2 + 1.0f) * knots[k].y
+        + (t3 - 2.0f * t2 + t) * dx * tangents[k]
+        + (-2.0f * t3 + 3.0f * t2) * knots[k + 1].y
+        + (t3 - t2) * dx * tangents[k + 1];
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Core/TransferTable.h"
+#include "SharedCache.h"
+#include "TripleBuffer.h"
+#include "UpdateScheduler.h"
+#include <JuceHeader.h>
+
+class Clipper;
+
+using TransferTable = noisat::core::TransferTable;
+
+// Builds transfer tables for the custom curve on the message thread, at most
+// once per frame, whenever it changes or is switched on and hands them to the
+// audio thread. The built-in curve is cheaper to compute than to look up, so
+// it is never tabulated.
+// The custom curve is a monotone cubic spline through (0, 0) and a fixed
+// number of user-placed control points, evaluated at the same per-sample cost
+// as the built-in curve once it has been tabulated. Tables are shared with
+// every other instance using the same curve through a SharedCache.
+class TransferCurve : public juce::AudioProcessorParameter::Listener {
+public:
+    static constexpr size_t numControlPoints = 4;
+
+    TransferCurve(Clipper& clipper);
+    ~TransferCurve();
+
+    void parameterValueChanged(int parameterIndex, float newValue) override;
+    void parameterGestureChanged(
+        int parameterIndex, bool gestureIsStarting
+    ) override {};
+
+    // Message thread only.
+    juce::Point<float> getControlPoint(size_t index) const;
+    void setControlPoint(size_t index, juce::Point<float> point);
+    void evaluate(const float* in, float* out, size_t numSamples) const;
+
+    // Audio thread only. Returns the most recently built table, or the one
+    // getTable() returned last, without picking up a newer one.
+    const TransferTable& getTable();
+    const TransferTable& getLastTable() const;
+
+    // Builds a table for changed settings right away. For the audio thread
+    // while rendering offline, where the host may be blocking the message
+    // thread.
+    void updateNowIfNeeded() { tableUpdate.updateNowIfNeeded(); }
+
+private:
+    using CustomKey = std::array<float, numControlPoints * 2>;
+    using TablePointer = std::shared_ptr<const TransferTable>;
+
+    void rebuild();
+    void updateSpline();
+    void buildCustom(TransferTable& table) const;
+    float evaluateCustom(float x) const;
+
+    Clipper& clipper;
+
+    std::array<juce::Point<float>, numControlPoints> controlPoints;
+
+    // Spline knots sorted by x, including the fixed origin, and the
+    // Fritsch-Carlson tangents at each of them.
+    std::array<juce::Point<float>, numControlPoints + 1> knots;
+    std::array<float, numControlPoints + 1> tangents;
+
+    // Overwriting a buffer may drop the last reference to a table, which
+    // only ever happens on the writing side.
+    TripleBuffer<TablePointer> tables;
+    juce::SharedResourcePointer<SharedCache<CustomKey, TransferTable>>
+        customTables;
+    ScheduledUpdate tableUpdate{ [this] { rebuild(); } };
+};
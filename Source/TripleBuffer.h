@@ -0,0 +1,42 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Single-writer, single-reader handover of fixed-size state. The writer fills
+// the back buffer and publishes it, the reader picks up the most recently
+// published buffer. Neither side ever blocks, allocates or frees memory, so
+// the reader can safely live on the audio thread.
+template <typename T> class TripleBuffer {
+public:
+    // Writer side: the buffer to fill before calling publish().
+    T& getWriteBuffer() { return buffers[backIndex]; }
+
+    void publish() {
+        auto previous =
+            middle.exchange(backIndex | freshBit, std::memory_order_acq_rel);
+        backIndex = previous & indexMask;
+    }
+
+    // Reader side: switches to the latest published buffer, if any. Returns
+    // true when the read buffer changed.
+    bool update() {
+        if ((middle.load(std::memory_order_relaxed) & freshBit) == 0)
+            return false;
+
+        auto previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & indexMask;
+        return true;
+    }
+
+    const T& getReadBuffer() const { return buffers[frontIndex]; }
+
+private:
+    static constexpr int indexMask = 0x3;
+    static constexpr int freshBit = 0x4;
+
+    std::array<T, 3> buffers;
+
+    int backIndex = 0;
+    std::atomic<int> middle{ 1 };
+    int frontIndex = 2;
+};
@@ -0,0 +1,79 @@
+#include "UpdateScheduler.h"
+
+UpdateScheduler::~UpdateScheduler() {
+    cancelPendingUpdate();
+    stopTimer();
+}
+
+void UpdateScheduler::flush() {
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    // Nothing has been triggered since the last pass. A trigger() racing
+    // with this wakes the timer again.
+    if (numPending.load() == 0) {
+        stopTimer();
+        return;
+    }
+
+    juce::Array<ScheduledUpdate*> due;
+    {
+        const juce::ScopedLock sl(lock);
+        for (auto* update : updates) {
+            if (update->pending.load(std::memory_order_acquire)) {
+                due.add(update);
+            }
+        }
+    }
+
+    // A callback run earlier in the pass may have destroyed an update, so
+    // each one is looked up again, and its callback lock taken before
+    // letting go of the list keeps it alive until it has run. One busy on
+    // another thread is already being taken care of there.
+    for (auto* update : due) {
+        {
+            const juce::ScopedLock sl(lock);
+            if (!updates.contains(update)) continue;
+            if (!update->callbackLock.tryEnter()) continue;
+        }
+
+        update->runIfPending();
+        update->callbackLock.exit();
+    }
+}
+
+void UpdateScheduler::add(ScheduledUpdate* update) {
+    const juce::ScopedLock sl(lock);
+    updates.add(update);
+}
+
+void UpdateScheduler::remove(ScheduledUpdate* update) {
+    const juce::ScopedLock sl(lock);
+    updates.removeFirstMatchingValue(update);
+}
+
+void UpdateScheduler::addPending() {
+    if (numPending.fetch_add(1) == 0) triggerAsyncUpdate();
+}
+
+ScheduledUpdate::ScheduledUpdate(std::function<void()> fn)
+    : callback(std::move(fn)) {
+    scheduler->add(this);
+}
+
+ScheduledUpdate::~ScheduledUpdate() {
+    scheduler->remove(this);
+    const juce::ScopedLock sl(callbackLock);
+    if (pending.exchange(false)) scheduler->removePending();
+}
+
+void ScheduledUpdate::updateNowIfNeeded() {
+    const juce::ScopedLock sl(callbackLock);
+    runIfPending();
+}
+
+void ScheduledUpdate::runIfPending() {
+    if (!pending.exchange(false, std::memory_order_acq_rel)) return;
+
+    scheduler->removePending();
+    callback();
+}
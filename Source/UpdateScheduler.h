@@ -0,0 +1,82 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+class ScheduledUpdate;
+
+// Runs the pending updates of every ScheduledUpdate in the process in a single
+// pass on the message thread, once per display frame. Marking an update as
+// pending only sets a flag and never posts a message, so however fast the host
+// automates parameters, and however many instances are open, the message
+// thread does the same amount of work per frame.
+//
+// Shared between all instances through a juce::SharedResourcePointer, and
+// only ticking while updates are pending. The first trigger() after an idle
+// pass wakes it through an AsyncUpdater, whose message is posted without
+// blocking, so that idle instances cost the message thread nothing.
+class UpdateScheduler : private juce::Timer, private juce::AsyncUpdater {
+public:
+    static constexpr int refreshRate = 60;
+
+    ~UpdateScheduler() override;
+
+    // Message thread only. Runs every pending update right away, for callers
+    // that need the state to be in place before carrying on. Callbacks run
+    // without the scheduler's lock held, so they may create or destroy
+    // updates themselves.
+    void flush();
+
+private:
+    friend class ScheduledUpdate;
+
+    void add(ScheduledUpdate* update);
+    void remove(ScheduledUpdate* update);
+    void addPending();
+    void removePending() { numPending.fetch_sub(1); }
+    void timerCallback() override { flush(); }
+    void handleAsyncUpdate() override { startTimerHz(refreshRate); }
+
+    juce::CriticalSection lock;
+    juce::Array<ScheduledUpdate*> updates;
+
+    // Updates triggered and not yet run. The timer stops once a pass finds
+    // none left.
+    std::atomic<int> numPending{ 0 };
+};
+
+// A callback run by the UpdateScheduler on the message thread at most once per
+// frame, whenever trigger() has been called since the last run. Declare it
+// after everything the callback uses, so that it is destroyed first.
+class ScheduledUpdate {
+public:
+    explicit ScheduledUpdate(std::function<void()> callback);
+    ~ScheduledUpdate();
+
+    // Any thread, including the audio thread. Never blocks or allocates.
+    void trigger() {
+        if (!pending.exchange(true, std::memory_order_acq_rel)) {
+            scheduler->addPending();
+        }
+    }
+
+    // Runs the callback right away if it is pending. Normally called on the
+    // message thread only, but the processor also calls it from the audio
+    // thread while rendering offline, when the host may be blocking the
+    // message thread. Runs of the same callback never overlap.
+    void updateNowIfNeeded();
+
+private:
+    friend class UpdateScheduler;
+
+    void runIfPending();
+
+    std::function<void()> callback;
+    std::atomic<bool> pending{ false };
+
+    // Held while the callback runs, and by the destructor to wait for a run
+    // on another thread to finish.
+    juce::CriticalSection callbackLock;
+    juce::SharedResourcePointer<UpdateScheduler> scheduler;
+
+    JUCE_DECLARE_NON_COPYABLE(ScheduledUpdate)
+};
@@ -0,0 +1,1059 @@
+// Times Noisat's DSP hot paths in isolation and prints the results as JSON:
+//
+//   NoisatBench [--quick] [--double] [--filter <name>] [--min-time <ms>]
+//               [--output <file>] [--check]
+//
+//   --quick            Sweeps a handful of representative settings only.
+//   --double           Also times processBlock in double precision.
+//   --filter <name>    Only runs benchmarks whose name contains <name>.
+//   --min-time <ms>    Minimum duration of each timed run. Default 20.
+//   --output <file>    Writes the JSON there instead of to stdout.
+//   --check            Runs the correctness checks instead of the
+//                      benchmarks, and fails if any of them does.
+//
+// Every result is the median of several timed runs. Costs are given per
+// sample of one channel, at the rate the benchmarked code runs at: the host
+// rate for processBlock, the oversampled rate for the noise filters and
+// generator, and the host side rate for the oversampling stages. Cycles are
+// read from the time stamp counter, which ticks at the nominal clock rather
+// than the current core clock, and are null on CPUs without one.
+
+#include <JuceHeader.h>
+
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/UpdateScheduler.h"
+
+#include <chrono>
+#include <iostream>
+
+#if JUCE_INTEL
+#if JUCE_MSVC
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace {
+struct Settings {
+    bool quick = false;
+    bool doublePrecision = false;
+    juce::String filter;
+    double minSeconds = 0.02;
+    juce::File output;
+    bool check = false;
+};
+
+struct Sweep {
+    std::vector<int> blockSizes;
+    std::vector<double> sampleRates;
+    std::vector<int> channelCounts;
+    std::vector<int> factorIndices;
+};
+
+Sweep makeSweep(bool quick) {
+    if (quick) return { { 64, 512, 4096 }, { 48000.0 }, { 2 }, { 0, 2 } };
+
+    return { { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 },
+             { 44100.0, 48000.0, 96000.0, 192000.0 },
+             { 1, 2, 6 },
+             { 0, 1, 2, 3, 4 } };
+}
+
+constexpr int numRuns = 5;
+
+#if JUCE_INTEL
+constexpr bool hasCycleCounter = true;
+uint64_t readCycleCounter() { return __rdtsc(); }
+#else
+constexpr bool hasCycleCounter = false;
+uint64_t readCycleCounter() { return 0; }
+#endif
+
+struct Measurement {
+    double nsPerSample = 0.0;
+    double cyclesPerSample = 0.0;
+};
+
+// A sine with some noise on top, at `level`.
+template <typename SampleType>
+void fillTestSignal(
+    juce::AudioBuffer<SampleType>& buffer, double sampleRate, float level
+) {
+    juce::Random random(1);
+    for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
+        auto* samples = buffer.getWritePointer(channel);
+        for (int i = 0; i < buffer.getNumSamples(); i++) {
+            auto phase = juce::MathConstants<double>::twoPi * 220.0 * i
+                / sampleRate;
+            samples[i] = (SampleType)(
+                level
+                * (0.8 * std::sin(phase + channel)
+                   + 0.2 * (random.nextDouble() * 2.0 - 1.0))
+            );
+        }
+    }
+}
+
+class Benchmarks {
+public:
+    explicit Benchmarks(const Settings& s) : settings(s) {}
+
+    void run() {
+        auto sweep = makeSweep(settings.quick);
+
+        if (isSelected("processBlock")) benchmarkProcessBlock(sweep);
+        if (isSelected("clipperEvaluate")) benchmarkClipperEvaluate(sweep);
+        if (isSelected("clipperProcess")) benchmarkClipperProcess(sweep);
+        if (isSelected("clipperTable")) benchmarkClipperTable(sweep);
+        if (isSelected("noiseFilter")) benchmarkNoiseFilter(sweep);
+        if (isSelected("noiseGenerator")) benchmarkNoiseGenerator(sweep);
+        if (isSelected("multiband")) benchmarkMultiband(sweep);
+        if (isSelected("truePeak")) benchmarkTruePeak(sweep);
+        if (isSelected("oversampling")) benchmarkOversampling(sweep);
+    }
+
+    juce::var getReport() const {
+        auto* report = new juce::DynamicObject();
+        report->setProperty("cpu", juce::SystemStats::getCpuModel());
+        report->setProperty(
+            "cycleCounter", hasCycleCounter ? juce::var("tsc") : juce::var()
+        );
+        report->setProperty("minRunSeconds", settings.minSeconds);
+        report->setProperty("runs", numRuns);
+        report->setProperty("results", results);
+        return juce::var(report);
+    }
+
+private:
+    bool isSelected(const juce::String& name) const {
+        return settings.filter.isEmpty() || name.contains(settings.filter);
+    }
+
+    // Runs `function` for at least the minimum run time, numRuns times over,
+    // and returns the median. Each call processes `samplesPerCall` samples.
+    template <typename Function>
+    Measurement measure(juce::int64 samplesPerCall, Function&& function) {
+        using Clock = std::chrono::steady_clock;
+
+        // Warm up caches and branch predictors, and find how many calls it
+        // takes to fill a run.
+        int callsPerRun = 1;
+        for (;;) {
+            auto start = Clock::now();
+            for (int call = 0; call < callsPerRun; call++) function();
+            std::chrono::duration<double> elapsed = Clock::now() - start;
+
+            if (elapsed.count() >= settings.minSeconds) break;
+            callsPerRun *= 2;
+        }
+
+        std::array<Measurement, numRuns> runs;
+        auto samplesPerRun = (double)samplesPerCall * callsPerRun;
+
+        for (auto& run : runs) {
+            auto start = Clock::now();
+            auto startCycles = readCycleCounter();
+            for (int call = 0; call < callsPerRun; call++) function();
+            auto cycles = readCycleCounter() - startCycles;
+            std::chrono::duration<double, std::nano> elapsed =
+                Clock::now() - start;
+
+            run.nsPerSample = elapsed.count() / samplesPerRun;
+            run.cyclesPerSample = (double)cycles / samplesPerRun;
+        }
+
+        std::sort(
+            runs.begin(),
+            runs.end(),
+            [](const Measurement& a, const Measurement& b) {
+                return a.nsPerSample < b.nsPerSample;
+            }
+        );
+        return runs[numRuns / 2];
+    }
+
+    void addResult(
+        const juce::String& name, juce::DynamicObject* result,
+        const Measurement& measurement
+    ) {
+        result->setProperty("benchmark", name);
+        result->setProperty("nsPerSample", measurement.nsPerSample);
+        result->setProperty(
+            "cyclesPerSample",
+            hasCycleCounter ? juce::var(measurement.cyclesPerSample)
+                            : juce::var()
+        );
+        results.add(juce::var(result));
+
+        std::cerr << juce::JSON::toString(juce::var(result), true)
+                  << std::endl;
+    }
+
+    // Loud input keeps the processor on its oversampled path. Quiet input
+    // lets it bypass oversampling with the linear phase filters, and skip
+    // the clipping between the IIR ones, which silence skips as well once
+    // they have rung out. The input is restored before every call, so the
+    // copy is part of the measured cost.
+    template <typename SampleType>
+    void benchmarkProcessBlock(
+        const Sweep& sweep, NoisatAudioProcessor& processor,
+        const juce::String& precision
+    ) {
+        juce::MidiBuffer midi;
+        auto filter = processor.oversampler.filter->getCurrentChoiceName();
+
+        for (int factorIndex : sweep.factorIndices) {
+            *processor.oversampler.factor = factorIndex;
+
+            for (double sampleRate : sweep.sampleRates) {
+                for (int numChannels : sweep.channelCounts) {
+                    for (int blockSize : sweep.blockSizes) {
+                        processor.setPlayConfigDetails(
+                            numChannels, numChannels, sampleRate, blockSize
+                        );
+                        processor.prepareToPlay(sampleRate, blockSize);
+
+                        juce::AudioBuffer<SampleType> input(
+                            numChannels, blockSize
+                        );
+                        juce::AudioBuffer<SampleType> buffer(
+                            numChannels, blockSize
+                        );
+
+                        for (auto [signal, level] :
+                             { std::make_pair("loud", 1.5f),
+                               std::make_pair("quiet", 0.001f),
+                               std::make_pair("silence", 0.0f) }) {
+                            fillTestSignal(input, sampleRate, level);
+
+                            auto measurement = measure(
+                                (juce::int64)blockSize * numChannels,
+                                [&] {
+                                    buffer.makeCopyOf(input, true);
+                                    processor.processBlock(buffer, midi);
+                                }
+                            );
+
+                            auto* result = new juce::DynamicObject();
+                            result->setProperty("precision", precision);
+                            result->setProperty("filter", filter);
+                            result->setProperty("signal", signal);
+                            result->setProperty(
+                                "oversampling", 1 << factorIndex
+                            );
+                            result->setProperty("sampleRate", sampleRate);
+                            result->setProperty("channels", numChannels);
+                            result->setProperty("blockSize", blockSize);
+                            addResult("processBlock", result, measurement);
+                        }
+                    }
+                }
+            }
+        }
+
+        processor.releaseResources();
+    }
+
+    void benchmarkProcessBlock(const Sweep& sweep) {
+        NoisatAudioProcessor processor;
+
+        for (int filterIndex : { 0, 1 }) {
+            *processor.oversampler.filter = filterIndex;
+
+            processor.setProcessingPrecision(
+                juce::AudioProcessor::singlePrecision
+            );
+            benchmarkProcessBlock<float>(sweep, processor, "float");
+
+            if (settings.doublePrecision) {
+                processor.setProcessingPrecision(
+                    juce::AudioProcessor::doublePrecision
+                );
+                benchmarkProcessBlock<double>(sweep, processor, "double");
+            }
+        }
+    }
+
+    // Input spans the whole transfer curve: the linear range, the knee and
+    // hard clipping.
+    static std::vector<float> makeClipperInput(int numSamples) {
+        std::vector<float> input((size_t)numSamples);
+        for (int i = 0; i < numSamples; i++) {
+            input[(size_t)i] = 3.0f * (float)i / (float)numSamples - 1.5f;
+        }
+        return input;
+    }
+
+    void benchmarkClipperEvaluate(const Sweep& sweep) {
+        NoisatAudioProcessor processor;
+        const auto& clipper = processor.clipper;
+
+        for (int blockSize : sweep.blockSizes) {
+            auto input = makeClipperInput(blockSize);
+            std::vector<float> output((size_t)blockSize);
+
+            auto measurement = measure(blockSize, [&] {
+                for (size_t i = 0; i < input.size(); i++) {
+                    output[i] = clipper.evaluate(input[i]);
+                }
+            });
+
+            auto* result = new juce::DynamicObject();
+            result->setProperty("blockSize", blockSize);
+            addResult("clipperEvaluate", result, measurement);
+        }
+    }
+
+    void benchmarkClipperProcess(const Sweep& sweep) {
+        NoisatAudioProcessor processor;
+        auto shape = processor.clipper.getShape();
+
+        for (int blockSize : sweep.blockSizes) {
+            auto input = makeClipperInput(blockSize);
+            std::vector<float> output((size_t)blockSize);
+
+            auto measurement = measure(blockSize, [&] {
+                Clipper::process(
+                    shape, input.data(), output.data(), (size_t)blockSize
+                );
+            });
+
+            auto* result = new juce::DynamicObject();
+            result->setProperty("blockSize", blockSize);
+            addResult("clipperProcess", result, measurement);
+        }
+    }
+
+    // The default soft knee looked up in a table laid out like a custom
+    // curve's, for comparison with clipperProcess. The built-in curve is
+    // only worth tabulating while this is the faster of the two.
+    void benchmarkClipperTable(const Sweep& sweep) {
+        NoisatAudioProcessor processor;
+        const auto& clipper = processor.clipper;
+
+        auto table = std::make_unique<TransferTable>();
+        table->custom = true;
+        table->indexScale = (float)TransferTable::size;
+        for (int i = 0; i <= TransferTable::size; i++) {
+            table->values[(size_t)i] =
+                clipper.evaluate((float)i / (float)TransferTable::size);
+        }
+
+        for (int blockSize : sweep.blockSizes) {
+            auto input = makeClipperInput(blockSize);
+            std::vector<float> output((size_t)blockSize);
+
+            auto measurement = measure(blockSize, [&] {
+                table->process(input.data(), output.data(), (size_t)blockSize);
+            });
+
+            auto* result = new juce::DynamicObject();
+            result->setProperty("blockSize", blockSize);
+            addResult("clipperTable", result, measurement);
+        }
+    }
+
+    // The noise filters run at the oversampled rate, on blocks `factor`
+    // times the host block size.
+    void benchmarkNoiseFilter(const Sweep& sweep) {
+        noisat::core::NoiseFilter filter;
+        noisat::core::NoiseFilterSettings settings;
+
+        for (int factorIndex : sweep.factorIndices) {
+            for (double sampleRate : sweep.sampleRates) {
+                for (int numChannels : sweep.channelCounts) {
+                    for (int blockSize : sweep.blockSizes) {
+                        auto rate = sampleRate * (1 << factorIndex);
+                        auto numSamples = blockSize << factorIndex;
+
+                        filter.prepare(
+                            rate, numChannels, numSamples, settings
+                        );
+
+                        juce::AudioBuffer<float> buffer(
+                            numChannels, numSamples
+                        );
+                        fillTestSignal(buffer, rate, 0.5f);
+
+                        auto measurement = measure(
+                            (juce::int64)numSamples * numChannels,
+                            [&] {
+                                filter.beginBlock(
+                                    (size_t)numSamples, settings
+                                );
+                                filter.process(
+                                    buffer.getArrayOfWritePointers(),
+                                    (size_t)numChannels,
+                                    (size_t)numSamples
+                                );
+                            }
+                        );
+
+                        auto* result = new juce::DynamicObject();
+                        result->setProperty(
+                            "oversampling", 1 << factorIndex
+                        );
+                        result->setProperty("sampleRate", sampleRate);
+                        result->setProperty("channels", numChannels);
+                        result->setProperty("blockSize", blockSize);
+                        addResult("noiseFilter", result, measurement);
+                    }
+                }
+            }
+        }
+    }
+
+    void benchmarkNoiseGenerator(const Sweep& sweep) {
+        noisat::core::NoiseGenerator generator;
+        generator.setSeed(1);
+        generator.setCorrelation(0.5f);
+
+        for (int factorIndex : sweep.factorIndices) {
+            for (int numChannels : sweep.channelCounts) {
+                for (int blockSize : sweep.blockSizes) {
+                    auto numSamples = blockSize << factorIndex;
+                    generator.prepare(numChannels, numSamples);
+
+                    juce::AudioBuffer<float> buffer(numChannels, numSamples);
+                    juce::uint64 position = 0;
+
+                    auto measurement = measure(
+                        (juce::int64)numSamples * numChannels,
+                        [&] {
+                            generator.generate(
+                                buffer.getArrayOfWritePointers(),
+                                numSamples,
+                                position
+                            );
+                            position += (juce::uint64)numSamples;
+                        }
+                    );
+
+                    auto* result = new juce::DynamicObject();
+                    result->setProperty("oversampling", 1 << factorIndex);
+                    result->setProperty("channels", numChannels);
+                    result->setProperty("blockSize", blockSize);
+                    addResult("noiseGenerator", result, measurement);
+                }
+            }
+        }
+    }
+
+    // Runs at the oversampled rate like the noise filters. Every band clips,
+    // so that none of the work is skipped.
+    void benchmarkMultiband(const Sweep& sweep) {
+        noisat::core::MultibandClipper bands;
+        noisat::core::MultibandSettings settings;
+        for (auto& band : settings.bands) {
+            band.clipThres = 0.3f;
+            band.clipKnee = 0.5f;
+            band.clipRatio = 4.0f;
+        }
+
+        noisat::core::Parameters params;
+        params.dryWet = 0.5f;
+
+        for (int numBands = 2; numBands <= noisat::core::maxBands; numBands++) {
+            settings.numBands = numBands;
+
+            for (int factorIndex : sweep.factorIndices) {
+                for (int numChannels : sweep.channelCounts) {
+                    for (int blockSize : sweep.blockSizes) {
+                        auto rate = 48000.0 * (1 << factorIndex);
+                        auto numSamples = blockSize << factorIndex;
+                        bands.prepare(rate, numChannels);
+
+                        juce::AudioBuffer<float> buffer(
+                            numChannels, numSamples
+                        );
+                        juce::AudioBuffer<float> noise(
+                            numChannels, numSamples
+                        );
+                        fillTestSignal(buffer, rate, 0.5f);
+                        fillTestSignal(noise, rate, 0.1f);
+
+                        auto measurement = measure(
+                            (juce::int64)numSamples * numChannels,
+                            [&] {
+                                bands.beginBlock(settings);
+                                bands.process(
+                                    buffer.getArrayOfWritePointers(),
+                                    noise.getArrayOfReadPointers(),
+                                    numSamples,
+                                    params
+                                );
+                            }
+                        );
+
+                        auto* result = new juce::DynamicObject();
+                        result->setProperty("bands", numBands);
+                        result->setProperty(
+                            "oversampling", 1 << factorIndex
+                        );
+                        result->setProperty("channels", numChannels);
+                        result->setProperty("blockSize", blockSize);
+                        addResult("multiband", result, measurement);
+                    }
+                }
+            }
+        }
+    }
+
+    // Runs at the oversampled rate. The buffer is processed in place, so after
+    // the first run it sits right at the ceiling, like the output of a hard
+    // clipper would.
+    void benchmarkTruePeak(const Sweep& sweep) {
+        noisat::core::TruePeakCeiling ceiling;
+
+        for (int factorIndex : sweep.factorIndices) {
+            for (int numChannels : sweep.channelCounts) {
+                for (int blockSize : sweep.blockSizes) {
+                    auto factor = 1 << factorIndex;
+                    auto rate = 48000.0 * factor;
+                    auto numSamples = blockSize << factorIndex;
+                    ceiling.prepare(
+                        rate, factor, Oversampler::maxFactor, numChannels
+                    );
+
+                    juce::AudioBuffer<float> buffer(numChannels, numSamples);
+                    fillTestSignal(buffer, rate, 0.5f);
+
+                    juce::uint64 position = 0;
+                    auto measurement = measure(
+                        (juce::int64)numSamples * numChannels,
+                        [&] {
+                            ceiling.process(
+                                buffer.getArrayOfWritePointers(),
+                                numSamples,
+                                position,
+                                true,
+                                0.25f
+                            );
+                            position += (juce::uint64)numSamples;
+                        }
+                    );
+
+                    auto* result = new juce::DynamicObject();
+                    result->setProperty("oversampling", factor);
+                    result->setProperty("channels", numChannels);
+                    result->setProperty("blockSize", blockSize);
+                    addResult("truePeak", result, measurement);
+                }
+            }
+        }
+    }
+
+    // Same configuration as Oversampler builds for the processor.
+    void benchmarkOversampling(const Sweep& sweep) {
+        using Oversampling = juce::dsp::Oversampling<float>;
+
+        for (int factorIndex : sweep.factorIndices) {
+            if (factorIndex == 0) continue;
+
+            for (auto [filterName, filterType] :
+                 { std::make_pair(
+                       "IIR",
+                       Oversampling::FilterType::filterHalfBandPolyphaseIIR
+                   ),
+                   std::make_pair(
+                       "Linear Phase",
+                       Oversampling::FilterType::filterHalfBandFIREquiripple
+                   ) }) {
+                for (int numChannels : sweep.channelCounts) {
+                    for (int blockSize : sweep.blockSizes) {
+                        Oversampling oversampling(
+                            (size_t)numChannels,
+                            (size_t)factorIndex,
+                            filterType,
+                            true,
+                            true
+                        );
+                        oversampling.initProcessing((size_t)blockSize);
+
+                        juce::AudioBuffer<float> buffer(numChannels, blockSize);
+                        fillTestSignal(buffer, 48000.0, 0.5f);
+                        juce::dsp::AudioBlock<float> block(buffer);
+
+                        auto up = measure(
+                            (juce::int64)blockSize * numChannels,
+                            [&] { oversampling.processSamplesUp(block); }
+                        );
+                        auto down = measure(
+                            (juce::int64)blockSize * numChannels,
+                            [&] { oversampling.processSamplesDown(block); }
+                        );
+
+                        for (auto [name, measurement] :
+                             { std::make_pair("oversamplingUp", up),
+                               std::make_pair("oversamplingDown", down) }) {
+                            auto* result = new juce::DynamicObject();
+                            result->setProperty("filter", filterName);
+                            result->setProperty(
+                                "oversampling", 1 << factorIndex
+                            );
+                            result->setProperty("channels", numChannels);
+                            result->setProperty("blockSize", blockSize);
+                            addResult(name, result, measurement);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    const Settings& settings;
+    juce::Array<juce::var> results;
+};
+
+// Checks that the code timed above does what it should, with results in the
+// same format. Each one records the error it measured and the tolerance it
+// has to stay within.
+class Checks {
+public:
+    explicit Checks(const Settings& s) : settings(s) {}
+
+    // Returns true if every check passed.
+    bool run() {
+        if (isSelected("multibandCrossovers")) {
+            checkMultibandCrossovers<float>("float");
+            checkMultibandCrossovers<double>("double");
+        }
+        if (isSelected("truePeakBlockSizes")) checkTruePeakBlockSizes();
+        if (isSelected("philox")) checkPhilox();
+        if (isSelected("splitRender")) {
+            checkSplitRender<float>("float");
+            checkSplitRender<double>("double");
+        }
+        if (isSelected("offlineAllocations")) checkOfflineAllocations();
+        return passed;
+    }
+
+    juce::var getReport() const {
+        auto* report = new juce::DynamicObject();
+        report->setProperty("passed", passed);
+        report->setProperty("results", results);
+        return juce::var(report);
+    }
+
+private:
+    bool isSelected(const juce::String& name) const {
+        return settings.filter.isEmpty() || name.contains(settings.filter);
+    }
+
+    void addResult(
+        const juce::String& name, juce::DynamicObject* result, double error,
+        double tolerance
+    ) {
+        bool ok = error <= tolerance;
+        passed = passed && ok;
+
+        result->setProperty("check", name);
+        result->setProperty("error", error);
+        result->setProperty("tolerance", tolerance);
+        result->setProperty("passed", ok);
+        results.add(juce::var(result));
+
+        std::cerr << juce::JSON::toString(juce::var(result), true)
+                  << std::endl;
+    }
+
+    // Nothing clips below the threshold, so a blend of dry and wet has to
+    // pass a sine at unity gain. The crossover frequencies are where the
+    // bands turn the phase the furthest from the input's.
+    template <typename SampleType>
+    void checkMultibandCrossovers(const juce::String& precision) {
+        constexpr double sampleRate = 48000.0;
+        constexpr int numSamples = 96000;
+        constexpr int blockSize = 512;
+        constexpr double amplitude = 0.5;
+
+        noisat::core::Parameters params;
+        params.dryWet = 0.5f;
+
+        for (int numBands = 2; numBands <= noisat::core::maxBands; numBands++) {
+            noisat::core::MultibandSettings settings;
+            settings.numBands = numBands;
+
+            for (int split = 0; split < numBands - 1; split++) {
+                auto frequency = (double)settings.crossovers[(size_t)split];
+
+                noisat::core::MultibandClipper bands;
+                bands.prepare(sampleRate, 1);
+                bands.beginBlock(settings);
+
+                std::vector<SampleType> signal((size_t)numSamples);
+                for (int i = 0; i < numSamples; i++) {
+                    signal[(size_t)i] = (SampleType)(
+                        amplitude
+                        * std::sin(
+                            juce::MathConstants<double>::twoPi * frequency * i
+                            / sampleRate
+                        )
+                    );
+                }
+
+                for (int start = 0; start < numSamples; start += blockSize) {
+                    SampleType* channels[] = { signal.data() + start };
+                    bands.process<SampleType>(
+                        channels,
+                        nullptr,
+                        std::min(blockSize, numSamples - start),
+                        params
+                    );
+                }
+
+                // The second half, once the filters have settled.
+                double sumOfSquares = 0.0;
+                for (int i = numSamples / 2; i < numSamples; i++) {
+                    sumOfSquares +=
+                        (double)signal[(size_t)i] * signal[(size_t)i];
+                }
+                auto rms = std::sqrt(sumOfSquares / (numSamples / 2));
+                auto gain = rms / (amplitude / std::sqrt(2.0));
+
+                auto* result = new juce::DynamicObject();
+                result->setProperty("precision", precision);
+                result->setProperty("bands", numBands);
+                result->setProperty("frequency", frequency);
+                result->setProperty("gainDb", 20.0 * std::log10(gain));
+                addResult(
+                    "multibandCrossovers",
+                    result,
+                    std::abs(20.0 * std::log10(gain)),
+                    0.01
+                );
+            }
+        }
+    }
+
+    // The ceiling limits fixed sub-blocks behind its look-ahead, so the
+    // output must not change with the block size, down to the last bit. The
+    // blocks of the last run have random lengths.
+    void checkTruePeakBlockSizes() {
+        constexpr int numSamples = 48000;
+        constexpr float ceilingGain = 0.5f;
+
+        for (int factorIndex = 0; factorIndex <= Oversampler::maxFactorIndex;
+             factorIndex++) {
+            auto factor = 1 << factorIndex;
+            auto rate = 48000.0 * factor;
+            auto length = numSamples * factor;
+
+            // Clipped well past the ceiling, with harmonics near Nyquist.
+            std::vector<float> signal((size_t)length);
+            for (int i = 0; i < length; i++) {
+                auto t = juce::MathConstants<double>::twoPi * i / rate;
+                signal[(size_t)i] = (float)juce::jlimit(
+                    -0.8,
+                    0.8,
+                    1.5 * std::sin(60.0 * t) + 0.6 * std::sin(7000.0 * t)
+                        + 0.4 * std::sin(15000.0 * t + 1.0)
+                );
+            }
+
+            std::vector<float> reference;
+            double error = 0.0;
+            juce::Random random(1);
+
+            for (int blockSize : { 4096, 64, 1, 0 }) {
+                noisat::core::TruePeakCeiling ceiling;
+                ceiling.prepare(rate, factor, factor, 1);
+
+                auto output = signal;
+                for (int start = 0; start < length;) {
+                    auto size = blockSize > 0
+                        ? blockSize * factor
+                        : 1 + random.nextInt(1000 * factor);
+                    size = std::min(size, length - start);
+
+                    float* channels[] = { output.data() + start };
+                    ceiling.process(
+                        channels,
+                        size,
+                        (juce::uint64)start,
+                        true,
+                        ceilingGain
+                    );
+                    start += size;
+                }
+
+                if (reference.empty()) {
+                    reference = output;
+                    continue;
+                }
+                for (size_t i = 0; i < output.size(); i++) {
+                    error = std::max(
+                        error, (double)std::abs(output[i] - reference[i])
+                    );
+                }
+            }
+
+            auto* result = new juce::DynamicObject();
+            result->setProperty("oversampling", factor);
+            addResult("truePeakBlockSizes", result, error, 0.0);
+        }
+    }
+
+    // The known answers for Philox4x32-10 published with Random123, for a
+    // single counter and for a batch of them, which the noise generator uses.
+    // The error is the number of words that differ.
+    void checkPhilox() {
+        using noisat::core::PhiloxCounter;
+        using Words = noisat::core::Vec<uint32_t>;
+
+        struct Answer {
+            PhiloxCounter counter;
+            uint64_t key;
+            PhiloxCounter expected;
+        };
+        const Answer answers[] = {
+            { { 0, 0, 0, 0 },
+              0,
+              { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 } },
+            { { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+              0xffffffffffffffff,
+              { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd } },
+            { { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 },
+              0x299f31d0a4093822,
+              { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } },
+        };
+
+        for (const auto& answer : answers) {
+            auto single = noisat::core::philox(answer.counter, answer.key);
+
+            noisat::core::PhiloxCounters batch;
+            for (size_t word = 0; word < 4; word++) {
+                batch[word] = Words::broadcast(answer.counter[word]);
+            }
+            batch = noisat::core::philox(batch, answer.key);
+
+            int errors = 0;
+            for (size_t word = 0; word < 4; word++) {
+                errors += single[word] != answer.expected[word];
+
+                std::array<uint32_t, Words::size> lanes;
+                batch[word].store(lanes.data());
+                for (auto lane : lanes) {
+                    errors += lane != answer.expected[word];
+                }
+            }
+
+            auto* result = new juce::DynamicObject();
+            result->setProperty("counter", (int)(&answer - answers));
+            addResult("philox", result, errors, 0.0);
+        }
+    }
+
+    // Split renders are approximate. A piece starts the warm-up NoisatRender
+    // gives it ahead of where its output starts, from silent filters. By then
+    // it has to match a render in one piece to within the settling
+    // tolerance, with the slowest noise filters there are and oversampling
+    // with IIR filters. The error is the largest difference over a second of
+    // output.
+    template <typename SampleType>
+    void checkSplitRender(const juce::String& precision) {
+        constexpr double sampleRate = 48000.0;
+        constexpr int numChannels = 2;
+        constexpr int blockSize = 512;
+
+        auto createProcessor = [&] {
+            auto processor = std::make_unique<NoisatAudioProcessor>();
+            processor->setNonRealtime(true);
+            processor->setProcessingPrecision(
+                std::is_same_v<SampleType, double>
+                    ? juce::AudioProcessor::doublePrecision
+                    : juce::AudioProcessor::singlePrecision
+            );
+            processor->setSeed(1);
+            *processor->noiseEq.hpFreq = 4.0f;
+            *processor->noiseEq.hpQ = 40.0f;
+            *processor->noiseEq.lpFreq = 4000.0f;
+            *processor->noiseEq.lpQ = 40.0f;
+            *processor->truePeak = true;
+            *processor->oversampler.factor = 2;
+            *processor->oversampler.filter = 0;
+            juce::SharedResourcePointer<UpdateScheduler>()->flush();
+
+            processor->setPlayConfigDetails(
+                numChannels, numChannels, sampleRate, blockSize
+            );
+            processor->prepareToPlay(sampleRate, blockSize);
+            return processor;
+        };
+        auto whole = createProcessor();
+        auto piece = createProcessor();
+
+        // Laid out in blocks like NoisatRender does, with the piece starting
+        // a second in, after its warm-up.
+        auto warmUp = (juce::int64)std::ceil(
+            piece->getSettlingSeconds() * sampleRate / blockSize
+        ) * blockSize;
+        auto second = (juce::int64)sampleRate / blockSize * blockSize;
+        auto pieceStart = second;
+        auto outputStart = pieceStart + warmUp;
+        auto outputEnd = outputStart + second;
+        piece->setPosition(pieceStart);
+
+        // Loud enough to clip and to reach the ceiling, and the same at any
+        // position, whichever processor reads it.
+        using Buffer = juce::AudioBuffer<SampleType>;
+        auto fill = [&](Buffer& buffer, juce::int64 start) {
+            for (int channel = 0; channel < numChannels; channel++) {
+                auto* samples = buffer.getWritePointer(channel);
+                for (int i = 0; i < blockSize; i++) {
+                    auto t = juce::MathConstants<double>::twoPi
+                        * (double)(start + i) / sampleRate;
+                    samples[i] = (SampleType)(
+                        1.5 * std::sin(220.0 * t + channel)
+                        + 0.3 * std::sin(7000.0 * t)
+                    );
+                }
+            }
+        };
+
+        Buffer wholeBuffer(numChannels, blockSize);
+        Buffer pieceBuffer(numChannels, blockSize);
+        juce::MidiBuffer midi;
+        double error = 0.0;
+
+        for (juce::int64 start = 0; start < outputEnd; start += blockSize) {
+            fill(wholeBuffer, start);
+            whole->processBlock(wholeBuffer, midi);
+            if (start < pieceStart) continue;
+
+            fill(pieceBuffer, start);
+            piece->processBlock(pieceBuffer, midi);
+            if (start < outputStart) continue;
+
+            for (int channel = 0; channel < numChannels; channel++) {
+                auto* a = wholeBuffer.getReadPointer(channel);
+                auto* b = pieceBuffer.getReadPointer(channel);
+                for (int i = 0; i < blockSize; i++) {
+                    error = std::max(error, (double)std::abs(a[i] - b[i]));
+                }
+            }
+        }
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty("precision", precision);
+        result->setProperty("warmUpSeconds", (double)warmUp / sampleRate);
+        result->setProperty(
+            "differenceDb", juce::Decibels::gainToDecibels(error, -200.0)
+        );
+        addResult("splitRender", result, error, 1.0e-5);
+    }
+
+    // Rendering offline, the audio thread rebuilds whatever a parameter
+    // change calls for itself, which has to happen outside the part of the
+    // block that must not allocate. The error is the number of allocations
+    // the detector caught in there, which takes a build with
+    // NOISAT_DETECT_AUDIO_ALLOCATIONS, like the Debug one.
+    void checkOfflineAllocations() {
+        constexpr double sampleRate = 48000.0;
+        constexpr int numChannels = 2;
+        constexpr int blockSize = 512;
+
+        NoisatAudioProcessor processor;
+        processor.setNonRealtime(true);
+        *processor.noiseTable.enabled = true;
+        processor.setPlayConfigDetails(
+            numChannels, numChannels, sampleRate, blockSize
+        );
+        processor.prepareToPlay(sampleRate, blockSize);
+
+        juce::AudioBuffer<float> buffer(numChannels, blockSize);
+        juce::MidiBuffer midi;
+        auto before = ScopedNoAllocations::getNumViolations();
+
+        // The first round renders the noise table enabled above, the others
+        // rebuild the oversampling stage, the transfer table and the noise
+        // table in turn.
+        std::function<void()> changes[] = {
+            [] {},
+            [&] { *processor.oversampler.factor = 2; },
+            [&] { *processor.clipper.custom = true; },
+            [&] { *processor.noiseEq.hpFreq = 100.0f; },
+        };
+        for (auto& change : changes) {
+            change();
+            for (int block = 0; block < 4; block++) {
+                fillTestSignal(buffer, sampleRate, 1.5f);
+                processor.processBlock(buffer, midi);
+            }
+        }
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty("detector", NOISAT_DETECT_AUDIO_ALLOCATIONS != 0);
+        addResult(
+            "offlineAllocations",
+            result,
+            ScopedNoAllocations::getNumViolations() - before,
+            0.0
+        );
+        processor.releaseResources();
+    }
+
+    const Settings& settings;
+    juce::Array<juce::var> results;
+    bool passed = true;
+};
+} // namespace
+
+int main(int argc, char* argv[]) {
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    Settings settings;
+    for (int i = 1; i < argc; i++) {
+        auto arg = juce::String(juce::CharPointer_UTF8(argv[i]));
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--quick") {
+            settings.quick = true;
+        } else if (arg == "--double") {
+            settings.doublePrecision = true;
+        } else if (arg == "--filter" && hasValue) {
+            settings.filter = juce::CharPointer_UTF8(argv[++i]);
+        } else if (arg == "--min-time" && hasValue) {
+            settings.minSeconds =
+                juce::String(juce::CharPointer_UTF8(argv[++i])).getDoubleValue()
+                / 1000.0;
+        } else if (arg == "--output" && hasValue) {
+            settings.output =
+                juce::File::getCurrentWorkingDirectory().getChildFile(
+                    juce::CharPointer_UTF8(argv[++i])
+                );
+        } else if (arg == "--check") {
+            settings.check = true;
+        } else {
+            std::cerr << "Usage: NoisatBench [--quick] [--double] "
+                         "[--filter <name>] [--min-time <ms>] "
+                         "[--output <file>] [--check]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    juce::var report;
+    bool passed = true;
+
+    if (settings.check) {
+        Checks checks(settings);
+        passed = checks.run();
+        report = checks.getReport();
+    } else {
+        Benchmarks benchmarks(settings);
+        benchmarks.run();
+        report = benchmarks.getReport();
+    }
+
+    auto json = juce::JSON::toString(report);
+    if (settings.output == juce::File()) {
+        std::cout << json << std::endl;
+    } else if (!settings.output.replaceWithText(json)) {
+        std::cerr << "Can't write " << settings.output.getFullPathName()
+                  << std::endl;
+        return 1;
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,888 @@
+// Renders audio files through Noisat without a host, an editor or an audio
+// device:
+//
+//   NoisatRender [options] --output <dir> <file>...
+//
+//   --output <dir>       Where the rendered files are written.
+//   --preset <file>      Parameter values, one `id = value` pair per line.
+//                        Empty lines and lines starting with '#' are skipped.
+//   --set <id>=<value>   Sets one parameter, applied after the preset.
+//   --format <ext>       Output format, e.g. wav or flac. Defaults to the
+//                        format of each input file.
+//   --block <samples>    Block size passed to processBlock. Default 8192.
+//   --jobs <count>       Files, or pieces of files, rendered at once.
+//                        Defaults to the CPU count.
+//   --double             Processes in double precision.
+//   --seed <number>      Seed for the noise. Defaults to a random one, which
+//                        is printed with the result.
+//   --split <seconds>    Approximate split rendering: renders each file in
+//                        pieces of about this length, all at once, and joins
+//                        them. Not bit for bit the same as a render in one
+//                        piece, see below.
+//   --list               Prints every parameter id with its range and exits.
+//
+// Values are given in the parameter's own units, or as the item index for
+// choice parameters, e.g. `--set oversampling=3` for 8x.
+//
+// Each file is decoded, processed and encoded by three threads connected by
+// a small ring of blocks, so that disk and codec work overlaps with the DSP.
+//
+// The noise only depends on the seed and the position in the file, so
+// renders with the same seed, settings and block size are identical.
+//
+// Approximate split rendering lets a long file use every core. Each piece
+// gets a processor of its own, which first runs over the input before the
+// piece and discards the output, until its filters have settled into the
+// state a render in one piece would be in, to within
+// NoisatAudioProcessor::settlingTolerance. That takes longest with the noise
+// filters at low frequencies and high Q, up to a minute. The filter and
+// oversampler state can't be carried over, so the result is not bit for bit
+// the same as a render in one piece, only to within about -100 dB. Pieces
+// start on block boundaries, so that every block is processed the same way
+// as in a render in one piece.
+
+#include <JuceHeader.h>
+
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/UpdateScheduler.h"
+
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+struct Options {
+    juce::File outputDirectory;
+    juce::Array<juce::File> inputs;
+    juce::StringPairArray parameters;
+    juce::String format;
+    int blockSize = 8192;
+    int numJobs = juce::SystemStats::getNumCpus();
+    bool doublePrecision = false;
+    bool listParameters = false;
+    bool hasSeed = false;
+    juce::uint64 seed = 0;
+    double splitSeconds = 0.0;
+};
+
+juce::CriticalSection outputLock;
+
+void print(const juce::String& line) {
+    const juce::ScopedLock lock(outputLock);
+    std::cout << line << std::endl;
+}
+
+void printError(const juce::String& line) {
+    const juce::ScopedLock lock(outputLock);
+    std::cerr << line << std::endl;
+}
+
+bool addAssignment(juce::StringPairArray& parameters, juce::String text) {
+    text = text.upToFirstOccurrenceOf("#", false, false).trim();
+    if (text.isEmpty()) return true;
+    if (!text.containsChar('=')) return false;
+
+    parameters.set(
+        text.upToFirstOccurrenceOf("=", false, false).trim(),
+        text.fromFirstOccurrenceOf("=", false, false).trim()
+    );
+    return true;
+}
+
+bool parseArguments(
+    const juce::StringArray& args, Options& options, juce::String& error
+) {
+    juce::StringPairArray preset;
+    juce::StringPairArray overrides;
+
+    for (int i = 0; i < args.size(); i++) {
+        const auto& arg = args[i];
+        bool hasValue = i + 1 < args.size();
+
+        auto takeValue = [&]() -> juce::String {
+            return hasValue ? args[++i] : juce::String();
+        };
+
+        if (arg == "--list") {
+            options.listParameters = true;
+        } else if (arg == "--double") {
+            options.doublePrecision = true;
+        } else if (arg == "--output" && hasValue) {
+            options.outputDirectory =
+                juce::File::getCurrentWorkingDirectory().getChildFile(
+                    takeValue()
+                );
+        } else if (arg == "--preset" && hasValue) {
+            auto file = juce::File::getCurrentWorkingDirectory().getChildFile(
+                takeValue()
+            );
+            if (!file.existsAsFile()) {
+                error = "Can't read preset " + file.getFullPathName();
+                return false;
+            }
+
+            juce::StringArray lines;
+            file.readLines(lines);
+            for (const auto& line : lines) {
+                if (!addAssignment(preset, line)) {
+                    error = "Malformed preset line: " + line;
+                    return false;
+                }
+            }
+        } else if (arg == "--set" && hasValue) {
+            auto assignment = takeValue();
+            if (!addAssignment(overrides, assignment)) {
+                error = "Expected <id>=<value>, got " + assignment;
+                return false;
+            }
+        } else if (arg == "--format" && hasValue) {
+            options.format = takeValue().trimCharactersAtStart(".");
+        } else if (arg == "--block" && hasValue) {
+            options.blockSize = takeValue().getIntValue();
+        } else if (arg == "--jobs" && hasValue) {
+            options.numJobs = takeValue().getIntValue();
+        } else if (arg == "--seed" && hasValue) {
+            options.hasSeed = true;
+            options.seed = (juce::uint64)takeValue().getLargeIntValue();
+        } else if (arg == "--split" && hasValue) {
+            options.splitSeconds = takeValue().getDoubleValue();
+            if (options.splitSeconds <= 0.0) {
+                error = "Split length must be positive";
+                return false;
+            }
+        } else if (arg.startsWith("--")) {
+            error = "Unknown or incomplete option " + arg;
+            return false;
+        } else {
+            options.inputs.add(
+                juce::File::getCurrentWorkingDirectory().getChildFile(arg)
+            );
+        }
+    }
+
+    options.parameters = preset;
+    options.parameters.addArray(overrides);
+
+    if (options.listParameters) return true;
+
+    if (options.inputs.isEmpty()) {
+        error = "No input files given";
+        return false;
+    }
+    if (options.outputDirectory == juce::File()) {
+        error = "No output directory given";
+        return false;
+    }
+    if (options.blockSize <= 0 || options.numJobs <= 0) {
+        error = "Block size and job count must be positive";
+        return false;
+    }
+    return true;
+}
+
+juce::RangedAudioParameter*
+findParameter(juce::AudioProcessor& processor, const juce::String& id) {
+    for (auto* parameter : processor.getParameters()) {
+        auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter);
+        if (ranged != nullptr && ranged->paramID == id) return ranged;
+    }
+    return nullptr;
+}
+
+bool applyParameters(
+    juce::AudioProcessor& processor, const juce::StringPairArray& values,
+    juce::String& error
+) {
+    for (const auto& id : values.getAllKeys()) {
+        auto* parameter = findParameter(processor, id);
+        if (parameter == nullptr) {
+            error = "Unknown parameter " + id;
+            return false;
+        }
+
+        auto text = values[id];
+        float value = text.getFloatValue();
+        if (text.equalsIgnoreCase("true") || text.equalsIgnoreCase("on")) {
+            value = 1.0f;
+        }
+
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    }
+    return true;
+}
+
+void listParameters() {
+    NoisatAudioProcessor processor;
+
+    for (auto* parameter : processor.getParameters()) {
+        auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter);
+        if (ranged == nullptr) continue;
+
+        const auto& range = ranged->getNormalisableRange();
+        print(
+            ranged->paramID + "\t" + juce::String(range.start) + " .. "
+            + juce::String(range.end) + "\tdefault "
+            + juce::String(range.convertFrom0to1(ranged->getDefaultValue()))
+        );
+    }
+}
+
+// Runs `function` on the message thread and waits for it to finish.
+template <typename Function> void callOnMessageThread(Function&& function) {
+    juce::WaitableEvent done;
+    juce::MessageManager::callAsync([&] {
+        function();
+        done.signal();
+    });
+    done.wait();
+}
+
+// Processors are also destroyed on the message thread, where their parameter
+// listeners live.
+struct DeleteOnMessageThread {
+    void operator()(NoisatAudioProcessor* processor) const {
+        callOnMessageThread([processor] { delete processor; });
+    }
+};
+
+using ProcessorPointer =
+    std::unique_ptr<NoisatAudioProcessor, DeleteOnMessageThread>;
+
+// The cached noise table is rendered in the background. Offline, the whole
+// file should use it rather than just the part after it is ready.
+void waitForNoiseTable(NoisatAudioProcessor& processor) {
+    if (!processor.noiseTable.enabled->get()) return;
+
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        processor.noiseTable.update();
+        if (processor.noiseTable.isReady()) return;
+        juce::Thread::sleep(5);
+    }
+}
+
+// Sets up a processor with the parameters from the command line and the
+// noise drawn from `seed`, ready for the first block.
+ProcessorPointer createProcessor(
+    const Options& options, int numChannels, double sampleRate,
+    juce::uint64 seed, juce::String& error
+) {
+    ProcessorPointer processor;
+    callOnMessageThread([&] {
+        processor.reset(new NoisatAudioProcessor());
+        processor->setNonRealtime(true);
+        processor->setProcessingPrecision(
+            options.doublePrecision ? juce::AudioProcessor::doublePrecision
+                                    : juce::AudioProcessor::singlePrecision
+        );
+        processor->setSeed(seed);
+        if (applyParameters(*processor, options.parameters, error)) {
+            // The parameter listeners defer rebuilding their state to the
+            // next frame. Flushing them here puts everything in place before
+            // the first block is processed.
+            juce::SharedResourcePointer<UpdateScheduler>()->flush();
+            processor->setPlayConfigDetails(
+                numChannels, numChannels, sampleRate, options.blockSize
+            );
+            processor->prepareToPlay(sampleRate, options.blockSize);
+        }
+    });
+    if (error.isNotEmpty()) return nullptr;
+
+    waitForNoiseTable(*processor);
+    return processor;
+}
+
+juce::File getOutputFile(const Options& options, const juce::File& input) {
+    auto extension = options.format.isNotEmpty()
+        ? options.format
+        : input.getFileExtension().trimCharactersAtStart(".");
+
+    return options.outputDirectory.getChildFile(
+        input.getFileNameWithoutExtension() + "." + extension
+    );
+}
+
+std::unique_ptr<juce::AudioFormatWriter> createWriter(
+    juce::AudioFormatManager& formats, const juce::File& output,
+    const juce::AudioFormatReader& reader, juce::String& error
+) {
+    auto extension = output.getFileExtension().trimCharactersAtStart(".");
+    auto* format = formats.findFormatForFileExtension(extension);
+    if (format == nullptr) {
+        error = "No encoder for ." + extension;
+        return nullptr;
+    }
+
+    output.deleteFile();
+
+    auto numChannels = (int)reader.numChannels;
+    auto bitDepth = (int)reader.bitsPerSample;
+    if (!format->getPossibleBitDepths().contains(bitDepth)) {
+        bitDepth = 24;
+    }
+
+    auto stream = output.createOutputStream();
+    if (stream == nullptr) {
+        error = "Can't write " + output.getFullPathName();
+        return nullptr;
+    }
+    std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(
+        stream.get(),
+        reader.sampleRate,
+        (unsigned int)numChannels,
+        bitDepth,
+        {},
+        0
+    ));
+    if (writer == nullptr) {
+        error = "Can't encode " + juce::String(numChannels) + " channels at "
+            + juce::String(reader.sampleRate) + " Hz as ." + extension;
+        return nullptr;
+    }
+    stream.release();
+
+    return writer;
+}
+
+// Processes the first `numSamples` samples of `buffer` in place. In double
+// precision they go through `doubleBuffer`, which must be large enough.
+void processInPlace(
+    NoisatAudioProcessor& processor, juce::AudioBuffer<float>& buffer,
+    int numSamples, juce::AudioBuffer<double>& doubleBuffer
+) {
+    auto numChannels = buffer.getNumChannels();
+    juce::MidiBuffer midi;
+
+    if (processor.isUsingDoublePrecision()) {
+        juce::AudioBuffer<double> view(
+            doubleBuffer.getArrayOfWritePointers(), numChannels, numSamples
+        );
+        for (int channel = 0; channel < numChannels; channel++) {
+            auto* in = buffer.getReadPointer(channel);
+            auto* out = view.getWritePointer(channel);
+            std::copy(in, in + numSamples, out);
+        }
+        processor.processBlock(view, midi);
+        for (int channel = 0; channel < numChannels; channel++) {
+            auto* in = view.getReadPointer(channel);
+            auto* out = buffer.getWritePointer(channel);
+            for (int i = 0; i < numSamples; i++) {
+                out[i] = (float)in[i];
+            }
+        }
+    } else {
+        juce::AudioBuffer<float> view(
+            buffer.getArrayOfWritePointers(), numChannels, numSamples
+        );
+        processor.processBlock(view, midi);
+    }
+}
+
+void printResult(
+    const juce::File& input, double duration, double seconds,
+    juce::uint64 seed
+) {
+    print(
+        input.getFileName() + ": " + juce::String(duration, 1) + " s in "
+        + juce::String(seconds, 2) + " s, "
+        + juce::String(duration / juce::jmax(seconds, 1.0e-6), 1)
+        + "x realtime, seed " + juce::String(seed)
+    );
+}
+
+juce::uint64 getSeed(const Options& options) {
+    return options.hasSeed
+        ? options.seed
+        : (juce::uint64)juce::Random::getSystemRandom().nextInt64();
+}
+
+std::atomic<bool> failed{ false };
+
+struct Block {
+    juce::AudioBuffer<float> buffer;
+    int numSamples = 0;
+    bool last = false;
+};
+
+// Blocking single producer, single consumer handover of blocks.
+class BlockQueue {
+public:
+    void push(Block* block) {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            blocks.push_back(block);
+        }
+        available.notify_one();
+    }
+
+    Block* pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait(lock, [this] { return !blocks.empty(); });
+
+        auto* block = blocks.front();
+        blocks.pop_front();
+        return block;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<Block*> blocks;
+};
+
+class RenderJob : public juce::ThreadPoolJob {
+public:
+    RenderJob(
+        const Options& o, juce::AudioFormatManager& f, const juce::File& in
+    )
+        : juce::ThreadPoolJob(in.getFileName()), options(o), formats(f),
+          input(in) {}
+
+    JobStatus runJob() override {
+        juce::String error;
+        if (!render(error)) {
+            printError(input.getFileName() + ": " + error);
+            failed = true;
+        }
+        return jobHasFinished;
+    }
+
+private:
+    // Blocks in flight between the three stages.
+    static constexpr int numBlocks = 4;
+
+    bool render(juce::String& error) {
+        std::unique_ptr<juce::AudioFormatReader> reader(
+            formats.createReaderFor(input)
+        );
+        if (reader == nullptr) {
+            error = "Unsupported or unreadable file";
+            return false;
+        }
+
+        auto seed = getSeed(options);
+        auto processor = createProcessor(
+            options, (int)reader->numChannels, reader->sampleRate, seed, error
+        );
+        if (processor == nullptr) return false;
+
+        auto writer = createWriter(
+            formats, getOutputFile(options, input), *reader, error
+        );
+        if (writer == nullptr) return false;
+
+        auto startTime = juce::Time::getMillisecondCounterHiRes();
+        process(*processor, *reader, *writer);
+        auto seconds =
+            (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+
+        writer.reset();
+
+        auto duration = (double)reader->lengthInSamples / reader->sampleRate;
+        printResult(input, duration, seconds, seed);
+        return true;
+    }
+
+    void process(
+        NoisatAudioProcessor& processor, juce::AudioFormatReader& reader,
+        juce::AudioFormatWriter& writer
+    ) {
+        auto numChannels = (int)reader.numChannels;
+        auto length = reader.lengthInSamples;
+
+        // The first `latency` samples out of the processor are dropped, and
+        // as many samples of silence past the end of the file flush out the
+        // rest. The reader pads reads past the end with zeros.
+        auto latency = (juce::int64)processor.getLatencySamples();
+
+        std::array<Block, numBlocks> blocks;
+        BlockQueue empty;
+        BlockQueue decoded;
+        BlockQueue processed;
+
+        for (auto& block : blocks) {
+            block.buffer.setSize(numChannels, options.blockSize);
+            empty.push(&block);
+        }
+
+        std::thread decoder([&] {
+            for (juce::int64 position = 0;;) {
+                auto* block = empty.pop();
+                block->numSamples = (int)juce::jmin(
+                    (juce::int64)options.blockSize, length + latency - position
+                );
+                reader.read(
+                    &block->buffer, 0, block->numSamples, position, true, true
+                );
+                position += block->numSamples;
+                block->last = position >= length + latency;
+
+                decoded.push(block);
+                if (block->last) break;
+            }
+        });
+
+        std::thread encoder([&] {
+            for (juce::int64 position = 0;;) {
+                auto* block = processed.pop();
+
+                auto start = juce::jmax((juce::int64)0, latency - position);
+                auto end = juce::jmin(
+                    (juce::int64)block->numSamples, latency + length - position
+                );
+                if (end > start) {
+                    writer.writeFromAudioSampleBuffer(
+                        block->buffer, (int)start, (int)(end - start)
+                    );
+                }
+                position += block->numSamples;
+
+                bool last = block->last;
+                empty.push(block);
+                if (last) break;
+            }
+        });
+
+        juce::AudioBuffer<double> doubleBuffer;
+        if (options.doublePrecision) {
+            doubleBuffer.setSize(numChannels, options.blockSize);
+        }
+
+        for (;;) {
+            auto* block = decoded.pop();
+            processInPlace(
+                processor, block->buffer, block->numSamples, doubleBuffer
+            );
+
+            bool last = block->last;
+            processed.push(block);
+            if (last) break;
+        }
+
+        decoder.join();
+        encoder.join();
+    }
+
+    const Options& options;
+    juce::AudioFormatManager& formats;
+    juce::File input;
+};
+
+// A file rendered in pieces, which are written out in order as they finish.
+class SplitFile {
+public:
+    SplitFile(
+        const juce::File& in, const juce::File& out,
+        std::unique_ptr<juce::AudioFormatWriter> w, int pieces,
+        double durationSeconds, juce::uint64 s
+    )
+        : input(in), seed(s), output(out), writer(std::move(w)),
+          finished((size_t)pieces), done((size_t)pieces, false),
+          duration(durationSeconds),
+          startTime(juce::Time::getMillisecondCounterHiRes()) {}
+
+    // Takes the rendered audio of piece `index`, or null if it failed. The
+    // job finishing the next piece due writes it, along with any later ones
+    // that are already done, so that no job waits for another.
+    void finishPiece(
+        int index, std::unique_ptr<juce::AudioBuffer<float>> audio
+    ) {
+        std::unique_lock<std::mutex> lock(mutex);
+        failedPieces += audio == nullptr ? 1 : 0;
+        finished[(size_t)index] = std::move(audio);
+        done[(size_t)index] = true;
+
+        if (isWriting) return;
+        isWriting = true;
+
+        while (nextToWrite < done.size() && done[nextToWrite]) {
+            auto piece = std::move(finished[nextToWrite]);
+            lock.unlock();
+
+            if (piece != nullptr) {
+                writer->writeFromAudioSampleBuffer(
+                    *piece, 0, piece->getNumSamples()
+                );
+            }
+
+            lock.lock();
+            nextToWrite++;
+        }
+        isWriting = false;
+
+        if (nextToWrite == done.size()) complete();
+    }
+
+    const juce::File input;
+    const juce::uint64 seed;
+
+private:
+    // A failed piece leaves the output incomplete, so it is removed.
+    void complete() {
+        writer.reset();
+
+        if (failedPieces > 0) {
+            output.deleteFile();
+            return;
+        }
+
+        auto seconds =
+            (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+        printResult(input, duration, seconds, seed);
+    }
+
+    juce::File output;
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<juce::AudioBuffer<float>>> finished;
+    std::vector<bool> done;
+    size_t nextToWrite = 0;
+    int failedPieces = 0;
+    bool isWriting = false;
+
+    double duration;
+    double startTime;
+};
+
+// Renders samples [start, end) of a split file.
+class PieceJob : public juce::ThreadPoolJob {
+public:
+    PieceJob(
+        const Options& o, juce::AudioFormatManager& f,
+        std::shared_ptr<SplitFile> file, int pieceIndex, juce::int64 from,
+        juce::int64 to
+    )
+        : juce::ThreadPoolJob(file->input.getFileName()), options(o),
+          formats(f), splitFile(std::move(file)), index(pieceIndex),
+          start(from), end(to) {}
+
+    JobStatus runJob() override {
+        juce::String error;
+        auto audio = render(error);
+        if (audio == nullptr) {
+            printError(splitFile->input.getFileName() + ": " + error);
+            failed = true;
+        }
+
+        splitFile->finishPiece(index, std::move(audio));
+        return jobHasFinished;
+    }
+
+private:
+    std::unique_ptr<juce::AudioBuffer<float>> render(juce::String& error) {
+        std::unique_ptr<juce::AudioFormatReader> reader(
+            formats.createReaderFor(splitFile->input)
+        );
+        if (reader == nullptr) {
+            error = "Unsupported or unreadable file";
+            return nullptr;
+        }
+
+        auto numChannels = (int)reader->numChannels;
+        auto sampleRate = reader->sampleRate;
+        auto processor = createProcessor(
+            options, numChannels, sampleRate, splitFile->seed, error
+        );
+        if (processor == nullptr) return nullptr;
+
+        // Processor output is `latency` samples behind the file. A render in
+        // one piece feeds the processor `latency` samples of silence past
+        // the end, in blocks counted from the start of the file.
+        auto length = reader->lengthInSamples;
+        auto latency = (juce::int64)processor->getLatencySamples();
+        auto inputEnd = length + latency;
+        auto outputStart = start + latency;
+        auto outputEnd = juce::jmin(end, length) + latency;
+
+        // Input processed ahead of the piece, and discarded, so that the
+        // filters settle into the state a render in one piece would be in.
+        auto blockSize = (juce::int64)options.blockSize;
+        auto warmUp = (juce::int64)std::ceil(
+            processor->getSettlingSeconds() * sampleRate / (double)blockSize
+        ) * blockSize;
+
+        auto audio = std::make_unique<juce::AudioBuffer<float>>(
+            numChannels, (int)(outputEnd - outputStart)
+        );
+        juce::AudioBuffer<float> buffer(numChannels, options.blockSize);
+        juce::AudioBuffer<double> doubleBuffer;
+        if (options.doublePrecision) {
+            doubleBuffer.setSize(numChannels, options.blockSize);
+        }
+
+        auto position = juce::jmax((juce::int64)0, start - warmUp);
+        processor->setPosition(position);
+
+        while (position < outputEnd) {
+            auto numSamples =
+                (int)juce::jmin(blockSize, inputEnd - position);
+            reader->read(&buffer, 0, numSamples, position, true, true);
+            processInPlace(*processor, buffer, numSamples, doubleBuffer);
+
+            auto from = juce::jmax(position, outputStart);
+            auto to = juce::jmin(position + numSamples, outputEnd);
+            for (int channel = 0; channel < numChannels && to > from;
+                 channel++) {
+                audio->copyFrom(
+                    channel,
+                    (int)(from - outputStart),
+                    buffer,
+                    channel,
+                    (int)(from - position),
+                    (int)(to - from)
+                );
+            }
+            position += numSamples;
+        }
+
+        return audio;
+    }
+
+    const Options& options;
+    juce::AudioFormatManager& formats;
+    std::shared_ptr<SplitFile> splitFile;
+    int index;
+    juce::int64 start;
+    juce::int64 end;
+};
+
+// Opens the output of a split file and queues a job for each of its pieces.
+class SplitJob : public juce::ThreadPoolJob {
+public:
+    SplitJob(
+        const Options& o, juce::AudioFormatManager& f, juce::ThreadPool& p,
+        const juce::File& in
+    )
+        : juce::ThreadPoolJob(in.getFileName()), options(o), formats(f),
+          pool(p), input(in) {}
+
+    JobStatus runJob() override {
+        juce::String error;
+        if (!split(error)) {
+            printError(input.getFileName() + ": " + error);
+            failed = true;
+        }
+        return jobHasFinished;
+    }
+
+private:
+    bool split(juce::String& error) {
+        std::unique_ptr<juce::AudioFormatReader> reader(
+            formats.createReaderFor(input)
+        );
+        if (reader == nullptr) {
+            error = "Unsupported or unreadable file";
+            return false;
+        }
+
+        auto output = getOutputFile(options, input);
+        auto writer = createWriter(formats, output, *reader, error);
+        if (writer == nullptr) return false;
+
+        // Pieces start on block boundaries, so that they are processed in
+        // the same blocks as in a render in one piece.
+        auto length = reader->lengthInSamples;
+        auto blockSize = (juce::int64)options.blockSize;
+        auto pieceLength = juce::jmax(
+            (juce::int64)1,
+            (juce::int64)std::ceil(
+                options.splitSeconds * reader->sampleRate / (double)blockSize
+            )
+        ) * blockSize;
+        auto numPieces = (int)juce::jmax(
+            (juce::int64)1, (length + pieceLength - 1) / pieceLength
+        );
+
+        auto file = std::make_shared<SplitFile>(
+            input,
+            output,
+            std::move(writer),
+            numPieces,
+            (double)length / reader->sampleRate,
+            getSeed(options)
+        );
+        for (int piece = 0; piece < numPieces; piece++) {
+            auto from = piece * pieceLength;
+            pool.addJob(
+                new PieceJob(
+                    options, formats, file, piece, from, from + pieceLength
+                ),
+                true
+            );
+        }
+        return true;
+    }
+
+    const Options& options;
+    juce::AudioFormatManager& formats;
+    juce::ThreadPool& pool;
+    juce::File input;
+};
+} // namespace
+
+int main(int argc, char* argv[]) {
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::StringArray args;
+    for (int i = 1; i < argc; i++) {
+        args.add(juce::CharPointer_UTF8(argv[i]));
+    }
+
+    Options options;
+    juce::String error;
+    if (!parseArguments(args, options, error)) {
+        printError(error);
+        printError(
+            "Usage: NoisatRender [--preset <file>] [--set <id>=<value>]... "
+            "[--format <ext>] [--block <samples>] [--jobs <count>] "
+            "[--double] [--seed <number>] [--split <seconds>] "
+            "--output <dir> <file>..."
+        );
+        printError(
+            "--split renders approximately: pieces match a render in one "
+            "piece to within about -100 dB, not bit for bit."
+        );
+        return 1;
+    }
+
+    if (options.listParameters) {
+        listParameters();
+        return 0;
+    }
+
+    if (!options.outputDirectory.createDirectory()) {
+        printError("Can't create " + options.outputDirectory.getFullPathName());
+        return 1;
+    }
+
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    bool split = options.splitSeconds > 0.0;
+    juce::ThreadPool pool(
+        split ? options.numJobs
+              : juce::jmin(options.numJobs, options.inputs.size())
+    );
+    for (const auto& input : options.inputs) {
+        if (split) {
+            pool.addJob(new SplitJob(options, formats, pool, input), true);
+        } else {
+            pool.addJob(new RenderJob(options, formats, input), true);
+        }
+    }
+
+    // The jobs call back into the message thread to set up their processors,
+    // so it has to keep dispatching until all of them are done.
+    auto* messageManager = juce::MessageManager::getInstance();
+    while (pool.getNumJobs() > 0) {
+        messageManager->runDispatchLoopUntil(20);
+    }
+
+    return failed ? 1 : 0;
+}